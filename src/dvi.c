@@ -7,7 +7,10 @@
 #include "g_config.h"
 #include "dvi.h"
 #include "pio_programs.h"
+#include "rgb_capture.h"
+#include "tmds.h"
 #include "v_buf.h"
+#include "video_output.h"
 
 #ifdef OSD_ENABLE
 #include "osd.h"
@@ -22,11 +25,30 @@ static uint offset;
 extern video_mode_t video_mode;
 extern int16_t h_visible_area;
 
-static uint32_t *v_out_dma_buf[2];
+static uint32_t *v_out_dma_buf[3];
 
 static uint64_t sync_data[4];
 // 2KB-aligned palette for better cache performance (compile-time alignment)
 static uint64_t palette[32] __attribute__((aligned(2048)));
+// dimmed scanlines: every colour one DAC level (85) darker, odd lines get a buffer of their own
+static uint64_t palette_dim[32];
+static bool scanlines_dim = false;
+#ifdef OSD_ENABLE
+// translucent OSD: the picture behind OSD background pixels at a third of the intensity
+static uint64_t palette_osd_bg[32];
+#endif
+// the palettes do not depend on the mode, they are built once
+static bool palette_ready = false;
+// current output line, a restart begins at the vertical blanking so the monitor gets a whole frame right away
+static uint16_t out_y = 0;
+
+// frame blending: TMDS palette of the mixed colours and its entry for every (current << 4 | previous) colour pair
+// the dimmed palette holds the same mixes for the scanline rows
+static uint64_t blend_palette[136 * 2];
+static uint64_t blend_palette_dim[136 * 2];
+static uint8_t blend_idx[256];
+static bool blend_ready = false;
+static bool blend_mode = false;
 
 static void __not_in_flash_func(memset64)(uint64_t *dst, const uint64_t data, uint32_t size)
 {
@@ -35,99 +57,127 @@ static void __not_in_flash_func(memset64)(uint64_t *dst, const uint64_t data, ui
     *dst++ = data;
 }
 
-static uint64_t get_ser_diff_data(uint16_t dataR, uint16_t dataG, uint16_t dataB)
+void set_dvi_palette(const uint32_t *rgb)
 {
-  uint64_t out64 = 0;
-  uint8_t d6;
-  uint8_t bR;
-  uint8_t bG;
-  uint8_t bB;
+  uint32_t dim[16];
+  uint32_t shade[16];
 
-  for (int i = 0; i < 10; i++)
+  for (int c = 0; c < 16; c++)
   {
-    out64 <<= 6;
-
-    if (i == 5)
-      out64 <<= 2;
-
-    bR = (dataR >> (9 - i)) & 1;
-    bG = (dataG >> (9 - i)) & 1;
-    bB = (dataB >> (9 - i)) & 1;
-
-#ifndef DVI_PINS_REVERSED
-    bR = 2 - bR;
-    bG = 2 - bG;
-    bB = 2 - bB;
-
-    d6 = (bB << 4) | (bG << 2) | (bR << 0);
-#else
-    bR = bR + 1;
-    bG = bG + 1;
-    bB = bB + 1;
-
-    d6 = (bR << 4) | (bG << 2) | (bB << 0);
-#endif
-
-    out64 |= d6;
+    dim[c] = 0;
+    shade[c] = 0;
+
+    for (int shift = 0; shift < 24; shift += 8)
+    {
+      uint8_t v = (rgb[c] >> shift) & 0xff;
+      dim[c] |= (uint32_t)(v > 85 ? v - 85 : 0) << shift;
+      shade[c] |= (uint32_t)(v / 3) << shift;
+    }
   }
 
-  return out64;
+  tmds_palette_init(palette, rgb, 16);
+  tmds_palette_init(palette_dim, dim, 16);
+#ifdef OSD_ENABLE
+  tmds_palette_init(palette_osd_bg, shade, 16);
+#endif
 }
 
-// TMDS encoder
-static uint tmds_encoder(uint8_t d8)
+// mixed colours of all pairs of palette colours, equal mixes share one TMDS palette entry
+// the dimmed mix of a pair uses the scanline colours, one DAC level (85) darker as in set_dvi_palette()
+static void blend_palette_init(const uint32_t *rgb)
 {
-  int s1 = 0;
-  uint8_t xnor = 0;
+  uint32_t mix[136]; // unordered pairs of 16 colours
+  uint32_t mix_dim[136];
+  int count = 0;
 
-  for (int i = 0; i < 8; i++)
-    s1 += (d8 & (1u << i)) ? 1 : 0;
+  for (int i = 0; i < 256; i++)
+  {
+    uint32_t a = rgb[i >> 4];
+    uint32_t b = rgb[i & 0x0f];
+    uint32_t m = 0;
+    uint32_t m_dim = 0;
+
+    for (int shift = 0; shift < 24; shift += 8)
+    {
+      uint8_t va = (a >> shift) & 0xff;
+      uint8_t vb = (b >> shift) & 0xff;
+
+      m |= ((va + vb) / 2) << shift;
+      m_dim |= (((va > 85 ? va - 85 : 0) + (vb > 85 ? vb - 85 : 0)) / 2) << shift;
+    }
 
-  if ((s1 > 4) || ((s1 == 4) && ((d8 & 1) == 0)))
-    xnor = 1;
+    int n = 0;
 
-  uint16_t d_out = d8 & 1;
-  uint16_t qi = d_out;
+    while (n < count && (mix[n] != m || mix_dim[n] != m_dim))
+      n++;
 
-  for (int i = 1; i < 8; i++)
-  {
-    d_out |= ((qi << 1) ^ (d8 & (1u << i))) ^ (xnor << i);
-    qi = d_out & (1u << i);
-  }
+    if (n == count)
+    {
+      mix[count] = m;
+      mix_dim[count++] = m_dim;
+    }
 
-  if (xnor == 1)
-    d_out |= 1u << 9;
-  else
-    d_out |= 1u << 8;
+    blend_idx[i] = n;
+  }
 
-  return d_out;
+  tmds_palette_init(blend_palette, mix, count);
+  tmds_palette_init(blend_palette_dim, mix_dim, count);
 }
 
-static void __not_in_flash_func(dma_handler_dvi)()
+static inline void __not_in_flash_func(render_dvi_line)()
 {
-  static uint16_t y = 0;
-
   static uint8_t *scr_buffer = NULL;
+  static uint8_t *prev_buffer = NULL;
+  static bool show_no_signal = false; // NO SIGNAL screen instead of the captured frame for this output frame
   static uint32_t active_buf_idx = 0;
 
   dma_hw->ints0 = 1u << dma_ch1;
 
-  dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[active_buf_idx & 1], false);
+  if (scanlines_dim)
+  { // the index keeps counting while the two-buffer path runs
+    if (active_buf_idx >= 3)
+      active_buf_idx = 0;
+
+    dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[active_buf_idx], false);
+  }
+  else
+    dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[active_buf_idx & 1], false);
 
-  y++;
+  uint16_t y = ++out_y;
 
   if (y == video_mode.whole_frame)
   {
-    y = 0;
+    y = out_y = 0;
+    mark_video_output_frame();
     scr_buffer = get_v_buf_out();
+    prev_buffer = get_v_buf_prev();
+    show_no_signal = no_signal;
+#ifdef OSD_ENABLE
+    osd_vblank();
+#endif
   }
 
-  if (y & 1)
-    return;
+  uint64_t *pal = palette;
+  uint64_t *active_buf;
 
-  active_buf_idx++;
+  if (scanlines_dim)
+  { // every line is rendered: three buffers in rotation, odd lines repeat the even ones through the dimmed palette
+    if (++active_buf_idx == 3)
+      active_buf_idx = 0;
 
-  uint64_t *active_buf = (uint64_t *)(v_out_dma_buf[active_buf_idx & 1]);
+    if (y & 1)
+      pal = palette_dim;
+
+    active_buf = (uint64_t *)(v_out_dma_buf[active_buf_idx]);
+  }
+  else
+  {
+    if (y & 1)
+      return;
+
+    active_buf_idx++;
+    active_buf = (uint64_t *)(v_out_dma_buf[active_buf_idx & 1]);
+  }
 
   if (scr_buffer == NULL)
     return;
@@ -135,16 +185,24 @@ static void __not_in_flash_func(dma_handler_dvi)()
   if (y < video_mode.v_visible_area)
   { // image area
     uint16_t scaled_y = y / video_mode.div;
-    uint8_t *scr_line = &scr_buffer[scaled_y * (V_BUF_W / 2)];
+    uint8_t *scr_line = show_no_signal ? get_no_signal_line(scaled_y) : &scr_buffer[scaled_y * (V_BUF_W / 2)];
     uint64_t *line_buf = active_buf;
 
+    // frame blending only for lines that differ from the previous frame
+    const uint8_t *prev_line = NULL;
+
+    if (blend_mode && !show_no_signal && prev_buffer != scr_buffer && v_buf_line_changed(scr_line, &prev_buffer[scaled_y * (V_BUF_W / 2)], h_visible_area))
+      prev_line = &prev_buffer[scaled_y * (V_BUF_W / 2)];
+
 #ifdef OSD_ENABLE
     // check if OSD is visible and overlaps with current scaled scanline
     bool osd_active = osd_state.visible && (scaled_y >= osd_mode.start_y && scaled_y < osd_mode.end_y);
 
     if (osd_active)
-    { // calculate OSD buffer line offset using scaled coordinates (2 pixels per byte)
-      uint8_t *osd_line = &osd_buffer[(scaled_y - osd_mode.start_y) * (osd_mode.width / 2)];
+    { // OSD line at scaled coordinates (2 pixels per byte)
+      const uint8_t *osd_line = osd_line_pixels(scaled_y - osd_mode.start_y);
+      // translucent OSD: background pixels show the picture through a darkened palette, black otherwise
+      const uint64_t *bg_pal = settings.osd_translucent ? palette_osd_bg : NULL;
 
       int x = 0;
 
@@ -155,43 +213,60 @@ static void __not_in_flash_func(dma_handler_dvi)()
           uint8_t pixel1 = c2 & 0xf;
           uint8_t pixel2 = c2 >> 4;
 
-          uint64_t *palette_ptr = &palette[pixel1 << 1];
+          uint64_t *palette_ptr = &pal[pixel1 << 1];
           *line_buf++ = *palette_ptr++;
           *line_buf++ = *palette_ptr;
 
-          palette_ptr = &palette[pixel2 << 1];
+          palette_ptr = &pal[pixel2 << 1];
           *line_buf++ = *palette_ptr++;
           *line_buf++ = *palette_ptr;
         }
       else
         for (; x < osd_mode.start_x; x++)
         {
-          scr_line++;
+          uint8_t c2 = *scr_line++;
 
-          uint64_t *palette_ptr = &palette[0];
+          const uint64_t *palette_ptr = bg_pal != NULL ? &bg_pal[(c2 & 0xf) << 1] : &pal[0];
           *line_buf++ = *palette_ptr++;
           *line_buf++ = *palette_ptr;
 
-          palette_ptr = &palette[0];
+          palette_ptr = bg_pal != NULL ? &bg_pal[(c2 >> 4) << 1] : &pal[0];
           *line_buf++ = *palette_ptr++;
           *line_buf++ = *palette_ptr;
         }
 
-      for (; x < osd_mode.end_x; x++)
-      { // ultra-simplified OSD compositing - byte-aligned boundaries (2-pixel aligned)
-        scr_line++;
-        uint8_t o2 = *osd_line++;
-        uint8_t pixel1 = o2 & 0xf;
-        uint8_t pixel2 = o2 >> 4;
+      if (bg_pal != NULL)
+        for (; x < osd_mode.end_x; x++)
+        { // every OSD background pixel is taken from the picture
+          uint8_t c2 = *scr_line++;
+          uint8_t o2 = *osd_line++;
+          uint8_t pixel1 = o2 & 0xf;
+          uint8_t pixel2 = o2 >> 4;
+
+          const uint64_t *palette_ptr = pixel1 != OSD_COLOR_BACKGROUND ? &pal[pixel1 << 1] : &bg_pal[(c2 & 0xf) << 1];
+          *line_buf++ = *palette_ptr++;
+          *line_buf++ = *palette_ptr;
 
-        uint64_t *palette_ptr = &palette[pixel1 << 1];
-        *line_buf++ = *palette_ptr++;
-        *line_buf++ = *palette_ptr;
+          palette_ptr = pixel2 != OSD_COLOR_BACKGROUND ? &pal[pixel2 << 1] : &bg_pal[(c2 >> 4) << 1];
+          *line_buf++ = *palette_ptr++;
+          *line_buf++ = *palette_ptr;
+        }
+      else
+        for (; x < osd_mode.end_x; x++)
+        { // ultra-simplified OSD compositing - byte-aligned boundaries (2-pixel aligned)
+          scr_line++;
+          uint8_t o2 = *osd_line++;
+          uint8_t pixel1 = o2 & 0xf;
+          uint8_t pixel2 = o2 >> 4;
 
-        palette_ptr = &palette[pixel2 << 1];
-        *line_buf++ = *palette_ptr++;
-        *line_buf++ = *palette_ptr;
-      }
+          uint64_t *palette_ptr = &pal[pixel1 << 1];
+          *line_buf++ = *palette_ptr++;
+          *line_buf++ = *palette_ptr;
+
+          palette_ptr = &pal[pixel2 << 1];
+          *line_buf++ = *palette_ptr++;
+          *line_buf++ = *palette_ptr;
+        }
 
       if (!osd_mode.full_width)
         for (; x < h_visible_area; x++)
@@ -200,44 +275,63 @@ static void __not_in_flash_func(dma_handler_dvi)()
           uint8_t pixel1 = c2 & 0xf;
           uint8_t pixel2 = c2 >> 4;
 
-          uint64_t *palette_ptr = &palette[pixel1 << 1];
+          uint64_t *palette_ptr = &pal[pixel1 << 1];
           *line_buf++ = *palette_ptr++;
           *line_buf++ = *palette_ptr;
 
-          palette_ptr = &palette[pixel2 << 1];
+          palette_ptr = &pal[pixel2 << 1];
           *line_buf++ = *palette_ptr++;
           *line_buf++ = *palette_ptr;
         }
       else
         for (; x < h_visible_area; x++)
         {
-          scr_line++;
+          uint8_t c2 = *scr_line++;
 
-          uint64_t *palette_ptr = &palette[0];
+          const uint64_t *palette_ptr = bg_pal != NULL ? &bg_pal[(c2 & 0xf) << 1] : &pal[0];
           *line_buf++ = *palette_ptr++;
           *line_buf++ = *palette_ptr;
 
-          palette_ptr = &palette[0];
+          palette_ptr = bg_pal != NULL ? &bg_pal[(c2 >> 4) << 1] : &pal[0];
           *line_buf++ = *palette_ptr++;
           *line_buf++ = *palette_ptr;
         }
     }
     else
 #endif
-      for (int x = 0; x < h_visible_area; x++)
-      { // no OSD - maximum speed path
-        uint8_t c2 = *scr_line++;
-        uint8_t pixel1 = c2 & 0xf;
-        uint8_t pixel2 = c2 >> 4;
-
-        uint64_t *palette_ptr = &palette[pixel1 << 1];
-        *line_buf++ = *palette_ptr++;
-        *line_buf++ = *palette_ptr;
-
-        palette_ptr = &palette[pixel2 << 1];
-        *line_buf++ = *palette_ptr++;
-        *line_buf++ = *palette_ptr;
+      if (prev_line != NULL)
+      { // frame blending - one extra table load per pixel
+        uint64_t *blend_pal = pal == palette_dim ? blend_palette_dim : blend_palette;
+
+        for (int x = 0; x < h_visible_area; x++)
+        {
+          uint8_t c2 = *scr_line++;
+          uint8_t p2 = *prev_line++;
+
+          uint64_t *palette_ptr = &blend_pal[blend_idx[((c2 & 0x0f) << 4) | (p2 & 0x0f)] << 1];
+          *line_buf++ = *palette_ptr++;
+          *line_buf++ = *palette_ptr;
+
+          palette_ptr = &blend_pal[blend_idx[(c2 & 0xf0) | (p2 >> 4)] << 1];
+          *line_buf++ = *palette_ptr++;
+          *line_buf++ = *palette_ptr;
+        }
       }
+      else
+        for (int x = 0; x < h_visible_area; x++)
+        { // no OSD - maximum speed path
+          uint8_t c2 = *scr_line++;
+          uint8_t pixel1 = c2 & 0xf;
+          uint8_t pixel2 = c2 >> 4;
+
+          uint64_t *palette_ptr = &pal[pixel1 << 1];
+          *line_buf++ = *palette_ptr++;
+          *line_buf++ = *palette_ptr;
+
+          palette_ptr = &pal[pixel2 << 1];
+          *line_buf++ = *palette_ptr++;
+          *line_buf++ = *palette_ptr;
+        }
 
     // horizontal sync
     memset64(active_buf + video_mode.h_visible_area, sync_data[0b00], video_mode.h_front_porch);
@@ -260,12 +354,26 @@ static void __not_in_flash_func(dma_handler_dvi)()
   }
 }
 
+// the line renderer has many exits, the ISR load is accounted around it
+static void __not_in_flash_func(dma_handler_dvi)()
+{
+  uint32_t start = systick_hw->cvr;
+
+  render_dvi_line();
+
+  out_isr_cycles += (start - systick_hw->cvr) & 0x00ffffff;
+}
+
 void start_dvi()
 {
   int whole_line = video_mode.whole_line * video_mode.div;
 
-  set_sys_clock_khz(video_mode.sys_freq, true);
-  sleep_ms(10);
+  // PLL relock and settling only when the system clock changes
+  if (clock_get_hz(clk_sys) != video_mode.sys_freq * 1000)
+  {
+    set_sys_clock_khz(video_mode.sys_freq, true);
+    sleep_ms(10);
+  }
 
   // initialization of constants
   const uint16_t b0 = 0b1101010100;
@@ -279,16 +387,32 @@ void start_dvi()
   sync_data[0b11] = get_ser_diff_data(b0, b0, b0);
 
   // palette initialization
-  for (int c = 0; c < 16; c++)
+  if (!palette_ready)
   {
-    uint8_t Y = (c >> 3) & 1;
-    uint8_t R = ((c >> 2) & 1) ? (Y ? 255 : 170) : 0;
-    uint8_t G = ((c >> 1) & 1) ? (Y ? 255 : 170) : 0;
-    uint8_t B = ((c >> 0) & 1) ? (Y ? 255 : 170) : 0;
-    palette[c * 2] = get_ser_diff_data(tmds_encoder(R), tmds_encoder(G), tmds_encoder(B));
-    palette[c * 2 + 1] = palette[c * 2] ^ 0x0003ffffffffffffl;
+    uint32_t rgb[16];
+
+    for (int c = 0; c < 16; c++)
+    {
+      uint8_t Y = (c >> 3) & 1;
+      uint8_t R = ((c >> 2) & 1) ? (Y ? 255 : 170) : 0;
+      uint8_t G = ((c >> 1) & 1) ? (Y ? 255 : 170) : 0;
+      uint8_t B = ((c >> 0) & 1) ? (Y ? 255 : 170) : 0;
+      rgb[c] = (R << 16) | (G << 8) | B;
+    }
+
+    set_dvi_palette(rgb);
+    blend_palette_init(rgb);
+    palette_ready = true;
   }
 
+  blend_mode = settings.blend_mode;
+  set_v_buf_keep_prev(blend_mode);
+
+  // SysTick on the system clock for the ISR load
+  systick_hw->rvr = 0x00ffffff;
+  systick_hw->cvr = 0;
+  systick_hw->csr = 0x5;
+
   // set DVI pins
   for (int i = DVI_PIN_D0; i < DVI_PIN_D0 + 6; i++)
   {
@@ -305,8 +429,21 @@ void start_dvi()
   }
 
   // buffers initialization
-  v_out_dma_buf[0] = calloc(whole_line, sizeof(uint32_t));
-  v_out_dma_buf[1] = calloc(whole_line, sizeof(uint32_t));
+  scanlines_dim = settings.scanlines_mode && settings.scanlines_dim;
+
+  // line buffers are carved from the static output arena and start as blank lines
+  for (int i = 0; i < (scanlines_dim ? 3 : 2); i++)
+  {
+    v_out_dma_buf[i] = &g_out_buf[i * whole_line];
+
+    uint64_t *line_buf = (uint64_t *)v_out_dma_buf[i];
+
+    memset64(line_buf, sync_data[0b00], video_mode.h_visible_area + video_mode.h_front_porch);
+    memset64(line_buf + video_mode.h_visible_area + video_mode.h_front_porch, sync_data[0b01], video_mode.h_sync_pulse);
+    memset64(line_buf + video_mode.h_visible_area + video_mode.h_front_porch + video_mode.h_sync_pulse, sync_data[0b00], video_mode.h_back_porch);
+  }
+
+  out_y = video_mode.v_visible_area;
 
   // PIO initialization
   pio_sm_config c = pio_get_default_sm_config();
@@ -376,6 +513,14 @@ void start_dvi()
   irq_set_enabled(DMA_IRQ_0, true);
 
   dma_start_channel_mask((1u << dma_ch0));
+
+  // the state machine stalled before the first line arrived, that is not an underrun
+  PIO_DVI->fdebug = 1u << (PIO_FDEBUG_TXSTALL_LSB + SM_DVI);
+}
+
+bool __not_in_flash_func(dvi_dma_busy)()
+{
+  return dma_channel_is_busy(dma_ch0) || dma_channel_is_busy(dma_ch1);
 }
 
 void stop_dvi()
@@ -397,16 +542,9 @@ void stop_dvi()
   dma_channel_unclaim(dma_ch0);
   dma_channel_unclaim(dma_ch1);
 
-  // free individual buffer allocations
-  if (v_out_dma_buf[0] != NULL)
-  {
-    free(v_out_dma_buf[0]);
-    v_out_dma_buf[0] = NULL;
-  }
+  // the buffers stay in the static arena for the next start
+  for (int i = 0; i < 3; i++)
+    v_out_dma_buf[i] = NULL;
 
-  if (v_out_dma_buf[1] != NULL)
-  {
-    free(v_out_dma_buf[1]);
-    v_out_dma_buf[1] = NULL;
-  }
+  set_v_buf_keep_prev(false);
 }
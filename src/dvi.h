@@ -1,4 +1,6 @@
 #pragma once
 
+void set_dvi_palette(const uint32_t *);
 void start_dvi();
+bool dvi_dma_busy();
 void stop_dvi();
\ No newline at end of file
@@ -19,8 +19,13 @@ typedef struct __attribute__((packed)) ff_osd_info_t
 extern ff_osd_display_t ff_osd_display;
 extern uint8_t ff_osd_buttons_rx;
 extern volatile bool ff_osd_needs_i2c_init;
+extern volatile uint32_t ff_osd_i2c_bytes;
+extern volatile uint32_t ff_osd_i2c_transactions;
+extern volatile uint32_t ff_osd_i2c_overflows;
+extern volatile uint32_t ff_osd_i2c_phantoms;
 
 void ff_osd_update();
+bool ff_osd_i2c_pending();
 void ff_osd_i2c_process();
 void ff_osd_i2c_init();
 void ff_osd_set_address();
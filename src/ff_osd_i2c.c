@@ -0,0 +1,444 @@
+// FlashFloppy OSD I2C slave: receive rings and the FlashFloppy / HD44780 (PCF8574 backpack) parsers
+// no display code, so it also builds on the host against a fake SDK (tools/ff_osd_replay)
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "hardware/sync.h"
+#include "pico/i2c_slave.h"
+
+#include "g_config.h"
+#include "ff_osd.h"
+
+// Cross-core flag: set from core0 menus when FF OSD is enabled after being
+// disabled at startup. Core1 loop picks this up and calls ff_osd_i2c_init().
+volatile bool ff_osd_needs_i2c_init = false;
+
+// Helper macros
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define MASK(r, x) ((x) & (ARRAY_SIZE(r) - 1))
+
+static const uint I2C_SLAVE_SDA_PIN = I2C_PIN_SDA;
+static const uint I2C_SLAVE_SCL_PIN = I2C_PIN_SCL;
+
+// 100 kHz: I2C Standard Mode, matching flashfloppy setting
+#define I2C_BAUDRATE 100000
+
+#define FF_OSD_FW_VER "1.9"
+
+// PCF8574 pin assignment: D7-D6-D5-D4-BL-EN-RW-RS
+#define _BL (1u << 3)
+#define _EN (1u << 2)
+#define _RW (1u << 1)
+#define _RS (1u << 0)
+
+// FF OSD command set
+#define FF_OSD_BACKLIGHT 0x00 // [0] = backlight on
+#define FF_OSD_DATA 0x02      // next columns*rows bytes are text data
+#define FF_OSD_ROWS 0x10      // [3:0] = #rows
+#define FF_OSD_HEIGHTS 0x20   // [3:0] = 1 iff row is 2x height
+#define FF_OSD_BUTTONS 0x30   // [3:0] = button mask
+#define FF_OSD_COLUMNS 0x40   // [6:0] = #columns
+
+extern settings_t settings;
+
+const char ff_osd_fw_ver[] = FF_OSD_FW_VER;
+
+// Display state, exported to display routines
+ff_osd_display_t ff_osd_display = {
+    .cols = 20,
+    .rows = 4,
+    .heights = 0,
+    .on = false,
+    .text = {},
+};
+
+uint8_t ff_osd_buttons_rx; // button state: Gotek -> OSD
+
+// state: OSD -> Gotek
+ff_osd_info_t ff_osd_info = {
+    .protocol_ver = 0,
+    .fw_major = ff_osd_fw_ver[0],
+    .fw_minor = ff_osd_fw_ver[2],
+    .buttons = 0};
+
+// I2C statistics
+volatile uint32_t ff_osd_i2c_bytes = 0;        // received and sent
+volatile uint32_t ff_osd_i2c_transactions = 0; // complete write transactions handed to the parser
+volatile uint32_t ff_osd_i2c_overflows = 0;    // write transactions dropped because a ring was full
+volatile uint32_t ff_osd_i2c_phantoms = 0;     // Stop / Restart without any byte
+
+// I2C data ring
+static uint8_t d_ring[1024];
+static uint16_t d_cons, d_prod; // data ring buffer consumer / producer pointers
+
+// Transaction ring: Data-ring offset of each transaction start
+static uint16_t t_ring[8];
+static uint16_t t_cons, t_prod; // transactions ring buffer consumer / producer pointers
+
+// End of the last complete transaction: t_prod << 16 | d_prod, one word so the consumer reads both at once
+// the consumer only parses up to here, a transaction still on the bus is left for the next wakeup
+static volatile uint32_t i2c_done;
+
+// Current position in FF OSD I2C Protocol character data.
+static uint8_t ff_osd_x, ff_osd_y;
+
+// LCD state
+static bool lcd_inc;
+static uint8_t lcd_ddraddr;
+
+void ff_osd_set_buttons(uint8_t buttons)
+{
+    ff_osd_info.buttons = buttons;
+}
+
+static void lcd_display_update(void)
+{
+    if (settings.ff_osd_config.i2c_protocol)
+        return;
+
+    ff_osd_display.rows = settings.ff_osd_config.rows;
+    ff_osd_display.cols = settings.ff_osd_config.cols;
+    ff_osd_display.heights = 0;
+    memset(ff_osd_display.text, ' ', sizeof(ff_osd_display.text));
+}
+
+static void __not_in_flash_func(lcd_process_cmd)(uint8_t cmd)
+{
+    uint8_t x = 0x80;
+    int c = 0;
+
+    if (!cmd)
+        return;
+
+    while (!(cmd & x))
+    {
+        x >>= 1;
+        c++;
+    }
+
+    switch (c)
+    {
+    case 0: // Set DDR Address
+        lcd_ddraddr = cmd & 127;
+        break;
+
+    case 1: // Set CGR Address
+        break;
+
+    case 2: // Function Set
+        break;
+
+    case 3: // Cursor or Display Shift
+        break;
+
+    case 4: // Display On/Off Control
+        break;
+
+    case 5: // Entry Mode Set
+        lcd_inc = (cmd & 2) != 0;
+        break;
+
+    case 6: // Return Home
+        lcd_ddraddr = 0;
+        break;
+
+    case 7: // Clear Display
+        memset(ff_osd_display.text, ' ', sizeof(ff_osd_display.text));
+        lcd_ddraddr = 0;
+        break;
+    }
+}
+
+static void __not_in_flash_func(lcd_process_dat)(uint8_t dat)
+{
+    int x, y;
+    if (lcd_ddraddr >= 0x68)
+        lcd_ddraddr = 0x00; // jump to line 2
+
+    if ((lcd_ddraddr >= 0x28) && (lcd_ddraddr < 0x40))
+        lcd_ddraddr = 0x40; // jump to line 1
+
+    x = lcd_ddraddr & 0x3f;
+    y = lcd_ddraddr >> 6;
+
+    if ((ff_osd_display.rows == 4) && (x >= 20))
+    {
+        x -= 20;
+        y += 2;
+    }
+
+    ff_osd_display.text[y][x] = dat;
+    lcd_ddraddr++;
+
+    if (x >= ff_osd_display.cols)
+    {
+        if (x + 1 > FF_OSD_COLUMNS_MAX)
+            ff_osd_display.cols = FF_OSD_COLUMNS_MAX;
+        else
+            ff_osd_display.cols = x + 1;
+    }
+}
+
+static void __not_in_flash_func(lcd_process)(void)
+{
+    uint32_t done = i2c_done;
+    uint16_t d_c, d_p = (uint16_t)done;
+    static uint16_t dat = 1;
+    static bool rs;
+
+    // Process the command sequence.
+    for (d_c = d_cons; d_c != d_p; d_c++)
+    {
+        uint8_t x = d_ring[MASK(d_ring, d_c)];
+
+        if ((x & (_EN | _RW)) != _EN)
+            continue;
+
+        ff_osd_display.on = !!(x & _BL);
+
+        if (rs != !!(x & _RS))
+        {
+            rs ^= 1;
+            dat = 1;
+        }
+
+        dat <<= 4;
+        dat |= x >> 4;
+
+        if (dat & 0x100)
+        {
+            if (rs)
+                lcd_process_dat(dat);
+            else
+                lcd_process_cmd(dat);
+
+            dat = 1;
+        }
+    }
+
+    d_cons = d_c;
+    t_cons = done >> 16; // the byte stream does not need the transaction starts
+}
+
+static void __not_in_flash_func(ffosd_process)(void)
+{
+    uint16_t d_c, d_p, t_c, t_p;
+    uint32_t done = i2c_done;
+
+    d_c = d_cons;
+    d_p = (uint16_t)done;
+    t_c = t_cons;
+    t_p = done >> 16;
+
+    // We only care about the last full transaction.
+    if ((uint16_t)(t_p - t_c) >= 2)
+    {
+        // Discard older transactions.
+        t_c = t_p - 1;
+        d_c = t_ring[MASK(t_ring, t_c)];
+        ff_osd_x = 0;
+        ff_osd_y = 0;
+    }
+
+    // Process the command sequence.
+    for (; d_c != d_p; d_c++)
+    {
+        uint8_t x = d_ring[MASK(d_ring, d_c)];
+
+        if ((t_c != t_p) && (d_c == t_ring[MASK(t_ring, t_c)]))
+        {
+            t_c++;
+            ff_osd_y = 0;
+        }
+
+        if (ff_osd_y != 0)
+        {
+            // Character Data.
+            ff_osd_display.text[ff_osd_y - 1][ff_osd_x] = x;
+
+            if (++ff_osd_x >= ff_osd_display.cols)
+            {
+                ff_osd_x = 0;
+
+                if (++ff_osd_y > ff_osd_display.rows)
+                    ff_osd_y = 0;
+            }
+        }
+        else
+        {
+            // Command.
+            if ((x & 0xc0) == FF_OSD_COLUMNS)
+            {
+                // 0-40
+                if ((x & 0x3f) > FF_OSD_COLUMNS_MAX)
+                    ff_osd_display.cols = FF_OSD_COLUMNS_MAX;
+                else
+                    ff_osd_display.cols = x & 0x3f;
+            }
+            else
+            {
+                switch (x & 0xf0)
+                {
+                case FF_OSD_BUTTONS:
+                    ff_osd_buttons_rx = x & 0x0f;
+                    break;
+
+                case FF_OSD_ROWS:
+                    // 0-3
+                    ff_osd_display.rows = x & 0x03;
+                    break;
+
+                case FF_OSD_HEIGHTS:
+                    ff_osd_display.heights = x & 0x0f;
+                    break;
+
+                case FF_OSD_BACKLIGHT:
+                    switch (x & 0x0f)
+                    {
+                    case 0:
+                        ff_osd_display.on = false;
+                        break;
+
+                    case 1:
+                        ff_osd_display.on = true;
+                        break;
+
+                    case 2:
+                        ff_osd_x = 0;
+                        ff_osd_y = 1;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    d_cons = d_c;
+    t_cons = t_c;
+}
+
+static void __not_in_flash_func(i2c_slave_handler)(i2c_inst_t *i2c, i2c_slave_event_t event)
+{
+    static uint8_t rp = 0;
+    static volatile bool addr_matched = false;
+    static bool receiving = false; // write transaction
+    static bool dropping = false;  // write transaction that did not fit
+
+    switch (event)
+    {
+    case I2C_SLAVE_RECEIVE: // master has written some data
+    {
+        // On address match (first RECEIVE after FINISH), mark transaction start
+        if (!addr_matched)
+        {
+            // A full ring drops the whole transaction, the parser never sees any of it
+            dropping = (uint16_t)(t_prod - t_cons) >= ARRAY_SIZE(t_ring);
+
+            if (!dropping)
+                t_ring[MASK(t_ring, t_prod++)] = d_prod;
+
+            rp = 0;
+            addr_matched = true;
+            receiving = true;
+        }
+        // Read incoming byte - ISR is called for each byte received
+        uint8_t x = i2c_read_byte_raw(i2c);
+        ff_osd_i2c_bytes++;
+
+        if (!dropping && (uint16_t)(d_prod - d_cons) >= ARRAY_SIZE(d_ring))
+        { // Take back the bytes already stored
+            d_prod = t_ring[MASK(t_ring, --t_prod)];
+            dropping = true;
+        }
+
+        if (!dropping)
+            d_ring[MASK(d_ring, d_prod++)] = x;
+
+        break;
+    }
+
+    case I2C_SLAVE_REQUEST: // master is requesting data
+        // On address match for read operation, just reset read position
+        if (!addr_matched)
+        {
+            rp = 0;
+            addr_matched = true;
+        }
+        // Send response byte - ISR is called for each byte requested
+        uint8_t *info = (uint8_t *)&ff_osd_info;
+        i2c_write_byte_raw(i2c, (rp < sizeof(ff_osd_info)) ? info[rp++] : 0);
+        ff_osd_i2c_bytes++;
+        break;
+
+    case I2C_SLAVE_FINISH: // master has signalled Stop / Restart
+        // Transaction complete - publish a write, wake up core 1 and reset for next transaction
+        if (!addr_matched)
+            ff_osd_i2c_phantoms++;
+        else if (dropping)
+            ff_osd_i2c_overflows++;
+        else if (receiving)
+        {
+            ff_osd_i2c_transactions++;
+            i2c_done = ((uint32_t)t_prod << 16) | d_prod;
+            __sev();
+        }
+
+        addr_matched = false;
+        receiving = false;
+        dropping = false;
+        break;
+
+    default:
+        break;
+    }
+}
+
+void ff_osd_i2c_init()
+{
+    static bool ff_osd_i2c_initialized = false;
+    if (ff_osd_i2c_initialized)
+        i2c_slave_deinit(I2C_INST);
+
+    // Apply config to display (important for LCD mode)
+    lcd_display_update();
+
+    // Initialize GPIO pins for I2C
+    gpio_init(I2C_SLAVE_SDA_PIN);
+    gpio_set_function(I2C_SLAVE_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_SLAVE_SDA_PIN);
+
+    gpio_init(I2C_SLAVE_SCL_PIN);
+    gpio_set_function(I2C_SLAVE_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(I2C_SLAVE_SCL_PIN);
+
+    // Initialize I2C peripheral at 100kHz
+    i2c_init(I2C_INST, I2C_BAUDRATE);
+
+    // Initialize I2C slave mode with our address and handler
+    uint8_t slave_addr = settings.ff_osd_config.i2c_protocol ? 0x10 : 0x27;
+
+    i2c_slave_init(I2C_INST, slave_addr, &i2c_slave_handler);
+
+    // Raise I2C IRQ priority above DMA IRQ (default 0x80) so the I2C handler can
+    // preempt the capture DMA handler.  Without this, a ~160µs DMA ISR blocks the
+    // I2C ISR long enough that a STOP condition and the last RX byte(s) accumulate
+    // simultaneously, causing phantom transactions that corrupt ff_osd_display parameters.
+    irq_set_priority(I2C0_IRQ + i2c_hw_index(I2C_INST), PICO_HIGHEST_IRQ_PRIORITY);
+
+    ff_osd_i2c_initialized = true;
+}
+
+void ff_osd_set_address()
+{
+    I2C_INST->hw->sar = settings.ff_osd_config.i2c_protocol ? 0x10 : 0x27;
+}
+
+// Complete transactions waiting to be parsed
+bool __not_in_flash_func(ff_osd_i2c_pending)(void)
+{
+    return (uint16_t)i2c_done != d_cons;
+}
+
+void __not_in_flash_func(ff_osd_i2c_process)(void)
+{
+    return settings.ff_osd_config.i2c_protocol ? ffosd_process() : lcd_process();
+}
@@ -0,0 +1,247 @@
+#include "pico/stdio_usb.h"
+#include "hardware/timer.h"
+#include "tusb.h"
+
+#include "g_config.h"
+#include "frame_grab.h"
+#include "rgb_capture.h"
+#include "telemetry.h"
+#include "v_buf.h"
+
+#define GRAB_LINE_BYTES (V_BUF_W / 2)
+// worst case: all literals, one control byte per 128
+#define GRAB_RECORD_MAX (sizeof(grab_record_t) + GRAB_LINE_BYTES + (GRAB_LINE_BYTES + 127) / 128)
+
+static uint8_t grab_mode;
+static bool grab_running = false;
+static bool grab_header_sent;
+static const uint8_t *grab_buf;
+static uint16_t grab_y;
+static uint32_t grab_frame;
+static uint32_t grab_crc;
+
+static uint8_t line_copy[GRAB_LINE_BYTES];
+static uint8_t record[GRAB_RECORD_MAX];
+
+// stream: 16 bits of the CRC-32 of every line last sent, a collision is repaired by the next keyframe
+static uint16_t stream_line_crc[V_BUF_H];
+static bool stream_frame_open;
+static uint32_t stream_last_frame;
+
+// PackBits-like: runs of 3 or more equal bytes, everything else as literals
+static uint16_t rle_encode(const uint8_t *src, uint16_t n, uint8_t *dst)
+{
+  uint8_t *d = dst;
+  uint16_t i = 0;
+
+  while (i < n)
+  {
+    uint16_t run = 1;
+
+    while (i + run < n && run < 130 && src[i + run] == src[i])
+      run++;
+
+    if (run >= 3)
+    {
+      *d++ = 0x80 | (run - 3);
+      *d++ = src[i];
+      i += run;
+      continue;
+    }
+
+    // literals up to the start of the next run of 3
+    uint16_t lit = 1;
+
+    while (i + lit < n && lit < 128 && !(i + lit + 2 < n && src[i + lit] == src[i + lit + 1] && src[i + lit] == src[i + lit + 2]))
+      lit++;
+
+    *d++ = lit - 1;
+    memcpy(d, &src[i], lit);
+    d += lit;
+    i += lit;
+  }
+
+  return d - dst;
+}
+
+static void send_line(uint16_t y, const uint8_t *line)
+{
+  grab_record_t *r = (grab_record_t *)record;
+
+  r->y = y;
+  r->length = rle_encode(line, GRAB_LINE_BYTES, record + sizeof(grab_record_t));
+
+  stdio_usb.out_chars((const char *)record, sizeof(grab_record_t) + r->length);
+}
+
+static void send_u32_record(uint16_t y, uint32_t value)
+{
+  grab_record_t r = {y, sizeof(value)};
+
+  memcpy(record, &r, sizeof(r));
+  memcpy(record + sizeof(r), &value, sizeof(value));
+  stdio_usb.out_chars((const char *)record, sizeof(r) + sizeof(value));
+}
+
+static void send_header()
+{
+  grab_header_t h = {GRAB_MAGIC, GRAB_VERSION, grab_mode, V_BUF_W, V_BUF_H};
+
+  stdio_usb.out_chars((const char *)&h, sizeof(h));
+}
+
+// a copy of a line of the shown buffer, NULL when the output moved to another buffer during the copy
+static const uint8_t *copy_shown_line(uint16_t y)
+{
+  uint8_t idx = v_buf_out_idx;
+
+  memcpy(line_copy, &((const uint8_t *)get_v_buf_shown())[y * GRAB_LINE_BYTES], GRAB_LINE_BYTES);
+
+  return idx == v_buf_out_idx ? line_copy : NULL;
+}
+
+// the stream waits for room in the FIFO instead of skipping lines, so the frame rate follows the link
+static void stream_update()
+{
+  uint8_t lines = STREAM_LINES_PER_PASS;
+
+  while (lines && tud_cdc_write_available() >= GRAB_RECORD_MAX)
+  {
+    if (!stream_frame_open)
+    {
+      uint32_t now = time_us_32();
+
+      if (now - stream_last_frame < STREAM_FRAME_US)
+        return;
+
+      stream_last_frame = now;
+
+      // keyframe: header for viewers that join now, and every line is sent (a cleared entry never matches)
+      if (grab_frame % STREAM_KEYFRAME_FRAMES == 0)
+      {
+        send_header();
+        memset(stream_line_crc, 0, sizeof(stream_line_crc));
+      }
+
+      send_u32_record(GRAB_FRAME_START, grab_frame);
+      stream_frame_open = true;
+      grab_y = 0;
+      grab_crc = 0;
+      continue;
+    }
+
+    if (grab_y == V_BUF_H)
+    {
+      send_u32_record(GRAB_LINE_END, grab_crc);
+      stream_frame_open = false;
+      grab_frame++;
+      continue;
+    }
+
+    const uint8_t *line = copy_shown_line(grab_y);
+
+    if (line == NULL)
+      continue;
+
+    lines--;
+
+    // bit 0 is always set in a stored value
+    uint16_t crc16 = (uint16_t)crc32_update(0, line, GRAB_LINE_BYTES) | 1;
+
+    if (crc16 == stream_line_crc[grab_y])
+    {
+      grab_y++;
+      continue;
+    }
+
+    stream_line_crc[grab_y] = crc16;
+    grab_crc = crc32_update(grab_crc, line, GRAB_LINE_BYTES);
+    send_line(grab_y++, line);
+  }
+}
+
+void frame_grab_start()
+{
+  grab_buf = v_buf_pin();
+  grab_mode = grab_buf != NULL ? GRAB_MODE_FRAME : GRAB_MODE_LINES;
+  grab_header_sent = false;
+  grab_y = 0;
+  grab_frame = frame_count;
+  grab_crc = 0;
+  grab_running = true;
+}
+
+void frame_stream_start()
+{
+  grab_mode = GRAB_MODE_STREAM;
+  grab_frame = 0;
+  stream_frame_open = false;
+  stream_last_frame = time_us_32() - STREAM_FRAME_US;
+  grab_running = true;
+}
+
+void frame_grab_stop()
+{
+  grab_running = false;
+  v_buf_unpin();
+}
+
+bool frame_grab_active()
+{
+  return grab_running;
+}
+
+// called from the main loop: sends as many records as the CDC TX FIFO takes without waiting
+void frame_grab_update()
+{
+  if (!grab_running)
+    return;
+
+  if (!stdio_usb_connected())
+  {
+    frame_grab_stop();
+    return;
+  }
+
+  if (grab_mode == GRAB_MODE_STREAM)
+  {
+    stream_update();
+    return;
+  }
+
+  if (!grab_header_sent)
+  {
+    if (tud_cdc_write_available() < sizeof(grab_header_t))
+      return;
+
+    send_header();
+    grab_header_sent = true;
+  }
+
+  while (tud_cdc_write_available() >= GRAB_RECORD_MAX)
+  {
+    if (grab_y == V_BUF_H)
+    {
+      send_u32_record(GRAB_LINE_END, grab_crc);
+      frame_grab_stop();
+      return;
+    }
+
+    const uint8_t *line;
+
+    if (grab_mode == GRAB_MODE_FRAME)
+      line = &grab_buf[grab_y * GRAB_LINE_BYTES];
+    else
+    { // capture writes this buffer all the time: copy one line right after a new frame has started
+      if (frame_count == grab_frame)
+        return;
+
+      grab_frame = frame_count;
+      memcpy(line_copy, &((const uint8_t *)get_v_buf_in_cur())[grab_y * GRAB_LINE_BYTES], GRAB_LINE_BYTES);
+      line = line_copy;
+    }
+
+    grab_crc = crc32_update(grab_crc, line, GRAB_LINE_BYTES);
+    send_line(grab_y++, line);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+// frame grabber and video stream over USB CDC, decoded on the host by tools/frame_grab.py and tools/stream_viewer.py
+// grab: header, one record per line, trailer; all fields little-endian
+// stream: a header every STREAM_KEYFRAME_FRAMES frames (all lines follow), then per frame
+// a start record, records of the changed lines and a trailer
+#define GRAB_MAGIC 0x475A // "ZG"
+#define GRAB_VERSION 1
+
+#define GRAB_MODE_FRAME 0 // pinned display buffer, one whole frame
+#define GRAB_MODE_LINES 1 // one line per captured frame (single buffering)
+#define GRAB_MODE_STREAM 2 // changed lines of the displayed buffer, continuously
+
+#define GRAB_LINE_END 0xffff     // y of the trailer record, its data is the CRC-32 of the raw lines sent
+#define GRAB_FRAME_START 0xfffe // y of the stream frame start record, its data is the uint32_t frame number
+
+typedef struct __attribute__((packed)) grab_header_t
+{
+  uint16_t magic;
+  uint8_t version;
+  uint8_t mode;
+  uint16_t width; // pixels, 4 bits each, the low nibble is the left pixel
+  uint16_t height;
+} grab_header_t;
+
+// record: uint16_t y, uint16_t length, RLE data
+// RLE control byte c: c < 0x80 -> c + 1 literal bytes follow, else the next byte repeats (c & 0x7f) + 3 times
+typedef struct __attribute__((packed)) grab_record_t
+{
+  uint16_t y;
+  uint16_t length;
+} grab_record_t;
+
+void frame_grab_start();
+void frame_stream_start();
+void frame_grab_stop();
+bool frame_grab_active();
+void frame_grab_update();
\ No newline at end of file
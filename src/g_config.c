@@ -119,6 +119,60 @@ video_mode_t mode_1280x1024_60Hz_d4 = {
     .div = 4,
 };
 
-video_mode_t *video_modes[] = {&mode_640x480_60Hz, &mode_720x576_50Hz, &mode_800x600_60Hz, &mode_1024x768_60Hz_d3, &mode_1024x768_60Hz_d4, &mode_1280x1024_60Hz_d3, &mode_1280x1024_60Hz_d4};
+// 50Hz modes (CVT timings, see tools/video_timing_solver.py): integer scaling of V_BUF_H lines for 50Hz sources
+video_mode_t mode_800x600_50Hz = {
+    .sys_freq = 184500,
+    .pixel_freq = 30750000.0,
+    .h_visible_area = 800,
+    .v_visible_area = 600,
+    .whole_line = 992,
+    .whole_frame = 621,
+    .h_front_porch = 24,
+    .h_sync_pulse = 72,
+    .h_back_porch = 96,
+    .v_front_porch = 3,
+    .v_sync_pulse = 4,
+    .v_back_porch = 14,
+    .sync_polarity = 0b11000000, // negative
+    .div = 2,
+};
+
+video_mode_t mode_1024x768_50Hz = {
+    .sys_freq = 234000,
+    .pixel_freq = 52000000.0,
+    .h_visible_area = 1024,
+    .v_visible_area = 768,
+    .whole_line = 1312,
+    .whole_frame = 793,
+    .h_front_porch = 40,
+    .h_sync_pulse = 104,
+    .h_back_porch = 144,
+    .v_front_porch = 3,
+    .v_sync_pulse = 4,
+    .v_back_porch = 18,
+    .sync_polarity = 0b11000000, // negative
+    .div = 2,
+};
+
+video_mode_t mode_1280x1024_50Hz_d3 = {
+    .sys_freq = 236000,
+    .pixel_freq = 88500000.0,
+    .h_visible_area = 1278, // 1280
+    .v_visible_area = 1024,
+    .whole_line = 1680,
+    .whole_frame = 1057,
+    .h_front_porch = 75, // 72
+    .h_sync_pulse = 129, // 128
+    .h_back_porch = 198, // 200
+    .v_front_porch = 3,
+    .v_sync_pulse = 7,
+    .v_back_porch = 23,
+    .sync_polarity = 0b11000000, // negative
+    .div = 3,
+};
+
+video_mode_t *video_modes[] = {&mode_640x480_60Hz, &mode_720x576_50Hz, &mode_800x600_60Hz, &mode_1024x768_60Hz_d3, &mode_1024x768_60Hz_d4, &mode_1280x1024_60Hz_d3, &mode_1280x1024_60Hz_d4,
+                               &mode_800x600_50Hz, &mode_1024x768_50Hz, &mode_1280x1024_50Hz_d3};
 
-uint8_t g_v_buf[V_BUF_SZ * 3];
\ No newline at end of file
+uint8_t g_v_buf[V_BUF_SZ * 3] __attribute__((aligned(4)));
+uint32_t g_out_buf[OUT_BUF_WORDS];
\ No newline at end of file
@@ -144,9 +144,22 @@ typedef enum video_out_mode_t
   MODE_1024x768_60Hz_d4,
   MODE_1280x1024_60Hz_d3,
   MODE_1280x1024_60Hz_d4,
-  VIDEO_MODE_MAX = MODE_1280x1024_60Hz_d4,
+  MODE_800x600_50Hz,
+  MODE_1024x768_50Hz,
+  MODE_1280x1024_50Hz_d3,
+  VIDEO_MODE_MAX = MODE_1280x1024_50Hz_d3,
 } video_out_mode_t;
 
+typedef enum scaling_mode_t
+{
+  SCALE_MODE_MIN,
+  SCALE_INTEGER = SCALE_MODE_MIN,
+  SCALE_FIT,
+  SCALE_ZOOM,
+  SCALE_2X,
+  SCALE_MODE_MAX = SCALE_2X,
+} scaling_mode_t;
+
 typedef enum cap_sync_mode_t
 {
   SYNC_MODE_MIN,
@@ -155,6 +168,18 @@ typedef enum cap_sync_mode_t
   SYNC_MODE_MAX = EXT,
 } cap_sync_mode_t;
 
+typedef enum boot_phase_t
+{
+  BOOT_VREG,
+  BOOT_SERIAL,
+  BOOT_SETTINGS,
+  BOOT_OUTPUT,
+  BOOT_WELCOME,
+  BOOT_CAPTURE,
+  BOOT_LOCK,
+  BOOT_PHASE_COUNT,
+} boot_phase_t;
+
 #ifdef OSD_FF_ENABLE
 typedef struct ff_osd_config_t
 {
@@ -178,7 +203,11 @@ typedef struct settings_t
   video_out_type_t video_out_type;
   video_out_mode_t video_out_mode;
   bool scanlines_mode;
+  bool scanlines_dim;
   bool buffering_mode;
+  scaling_mode_t scaling_mode;
+  bool blend_mode;
+  bool osd_translucent; // OSD background shows the darkened picture
   bool video_sync_mode;
   cap_sync_mode_t cap_sync_mode;
   uint32_t frequency;
@@ -218,14 +247,20 @@ extern video_mode_t mode_1024x768_60Hz_d3;
 extern video_mode_t mode_1024x768_60Hz_d4;
 extern video_mode_t mode_1280x1024_60Hz_d3;
 extern video_mode_t mode_1280x1024_60Hz_d4;
+extern video_mode_t mode_800x600_50Hz;
+extern video_mode_t mode_1024x768_50Hz;
+extern video_mode_t mode_1280x1024_50Hz_d3;
 
 extern video_mode_t *video_modes[];
 
 extern uint8_t g_v_buf[];
+extern uint32_t g_out_buf[];
+extern volatile uint32_t boot_time[];
 
 // settings MIN values
 #define VIDEO_OUT_TYPE_MIN OUTPUT_TYPE_MIN
 #define VIDEO_OUT_MODE_MIN VIDEO_MODE_MIN
+#define SCALING_MODE_MIN SCALE_MODE_MIN
 #define CAP_SYNC_MODE_MIN SYNC_MODE_MIN
 #define FREQUENCY_MIN 6000000
 #define EXT_CLK_DIVIDER_MIN 1
@@ -236,6 +271,7 @@ extern uint8_t g_v_buf[];
 // settings MAX values
 #define VIDEO_OUT_TYPE_MAX OUTPUT_TYPE_MAX
 #define VIDEO_OUT_MODE_MAX VIDEO_MODE_MAX
+#define SCALING_MODE_MAX SCALE_MODE_MAX
 #define CAP_SYNC_MODE_MAX SYNC_MODE_MAX
 #define FREQUENCY_MAX 8000000
 #define EXT_CLK_DIVIDER_MAX 5
@@ -247,6 +283,7 @@ extern uint8_t g_v_buf[];
 // settings DEFAULT values
 #define VIDEO_OUT_TYPE_DEF VGA
 #define VIDEO_OUT_MODE_DEF MODE_640x480_60Hz
+#define SCALING_MODE_DEF SCALE_INTEGER
 #define CAP_SYNC_MODE_DEF SELF
 #define FREQUENCY_DEF 7000000
 #define EXT_CLK_DIVIDER_DEF 2
@@ -265,8 +302,47 @@ extern uint8_t g_v_buf[];
 #define V_BUF_H 304
 #define V_BUF_SZ (V_BUF_H * V_BUF_W / 2)
 
-// enable scanlines on 640x480 and 800x600 resolutions
+// capture starts after this many consecutive frames with the same number of lines
+#define CAP_LOCK_FRAMES 2
+
+// sync watchdog: NO SIGNAL is shown when no VSYNC arrives within this time (a 50 Hz frame plus 10%)
+#define NO_SIGNAL_TIMEOUT_US 22000
+
+// health monitor: PIO FIFO and DMA checks from a timer IRQ, about once per 60 Hz frame
+#define HEALTH_POLL_US 16000
+// restart capture or output when its DMA chain has stopped
+// #define HEALTH_AUTO_RESTART
+
+// binary telemetry over USB CDC: packet rate in Hz
+#define TELEMETRY_RATE_MIN 1
+#define TELEMETRY_RATE_MAX 100
+#define TELEMETRY_RATE_DEF 10
+
+// video streaming over USB CDC: frame rate limit (the link usually limits it further), full refresh interval
+#define STREAM_FRAME_US 40000
+#define STREAM_KEYFRAME_FRAMES 64
+// lines compared per main loop pass, keeps the loop responsive when little has changed
+#define STREAM_LINES_PER_PASS 16
+
+// output line buffers of the active driver (VGA or DVI), sized for the largest user:
+// three DVI lines of 720x576 (864 pixels of two words each)
+#define OUT_BUF_WORDS (3 * 864 * 2)
+
+// fractional scaler (VGA only)
+// width of the active part of the line in square pixels: 4:3 PAL picture = 288 lines * 4 / 3
+#define FIT_ASPECT_W 384
+
+// border-crop zoom: paper area of the source in pixels at ZOOM_PAPER_FREQ and in lines
+// the detected picture is grown to at least this size, a new crop is applied after ZOOM_STABLE_FRAMES equal detections
+#define ZOOM_PAPER_W 256
+#define ZOOM_PAPER_H 192
+#define ZOOM_PAPER_FREQ 7000000
+#define ZOOM_HYSTERESIS 2
+#define ZOOM_STABLE_FRAMES 8
+
+// enable black scanlines on 640x480 and 800x600 resolutions
 // not enabled due to reduced image brightness and uneven line thickness caused by monitor scaler
+// dimmed scanlines (half-intensity palette) are always available on these resolutions
 // #define SCANLINES_ENABLE_LOW_RES
 
 // select scanline thickness for the 1024x768 and 1280x1024 DIV4 video modes
@@ -276,4 +352,8 @@ extern uint8_t g_v_buf[];
 
 #if defined(OSD_MENU_ENABLE) || defined(OSD_FF_ENABLE)
 #define OSD_ENABLE
-#endif
\ No newline at end of file
+#endif
+
+// compose the OSD from the text buffer while output lines are rendered instead of keeping a 14 KB pixel buffer
+// frees most of the SRAM (the output reads a 2 KB published copy of the text), the output ISR builds one OSD line strip per source line
+// #define OSD_TEXT_COMPOSITE
\ No newline at end of file
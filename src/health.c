@@ -0,0 +1,149 @@
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/timer.h"
+
+#include "g_config.h"
+#include "health.h"
+#include "dvi.h"
+#include "rgb_capture.h"
+#include "vga.h"
+#include "video_output.h"
+
+extern settings_t settings;
+extern video_out_type_t active_video_output;
+extern volatile bool restart_capture;
+
+health_event_t health_events[HEALTH_EVENT_COUNT];
+
+static int health_alarm = -1;
+#ifdef HEALTH_AUTO_RESTART
+static volatile bool restart_output = false;
+#endif
+// a DMA chain is reported as stopped after two polls in a row, one poll can fall between the chained channels
+static uint8_t cap_dma_idle = 0;
+static uint8_t out_dma_idle = 0;
+
+static void __not_in_flash_func(count_event)(health_event_id_t id, uint32_t now)
+{
+  health_events[id].count++;
+  health_events[id].last_time = now;
+}
+
+// poll the sticky PIO FDEBUG bits and the DMA channels of capture and output every HEALTH_POLL_US
+// a timer IRQ at the lowest priority on core 0: it keeps polling while the serial menu waits for input,
+// and the output DMA ISRs preempt it
+static void __not_in_flash_func(health_poll)()
+{
+  uint32_t now = timer_hw->timerawl;
+
+  timer_hw->intr = 1u << health_alarm;
+  timer_hw->alarm[health_alarm] = now + HEALTH_POLL_US;
+
+  // capture
+  uint32_t rx_stall = 1u << (PIO_FDEBUG_RXSTALL_LSB + SM_CAP);
+
+  if (PIO_CAP->fdebug & rx_stall)
+  {
+    PIO_CAP->fdebug = rx_stall;
+    count_event(HEALTH_CAP_OVERFLOW, now);
+  }
+
+  cap_dma_idle = capture_dma_busy() ? 0 : cap_dma_idle + 1;
+
+  if (cap_dma_idle == 2)
+  {
+    count_event(HEALTH_CAP_DMA_STOP, now);
+#ifdef HEALTH_AUTO_RESTART
+    restart_capture = true;
+#endif
+  }
+
+  // output
+  PIO pio;
+  uint sm;
+  bool dma_busy;
+
+  switch (active_video_output)
+  {
+  case DVI:
+    pio = PIO_DVI;
+    sm = SM_DVI;
+    dma_busy = dvi_dma_busy();
+    break;
+
+  case VGA:
+    pio = PIO_VGA;
+    sm = SM_VGA;
+    dma_busy = vga_dma_busy();
+    break;
+
+  default:
+    return;
+  }
+
+  // the state machine stalls while the output is switched, the new output clears its bits when it starts
+  if (is_video_output_switching())
+  {
+    out_dma_idle = 0;
+    return;
+  }
+
+  uint32_t tx_stall = 1u << (PIO_FDEBUG_TXSTALL_LSB + sm);
+  uint32_t tx_over = 1u << (PIO_FDEBUG_TXOVER_LSB + sm);
+  uint32_t fdebug = pio->fdebug & (tx_stall | tx_over);
+
+  if (fdebug & tx_stall)
+    count_event(HEALTH_OUT_UNDERRUN, now);
+
+  if (fdebug & tx_over)
+    count_event(HEALTH_OUT_OVERRUN, now);
+
+  pio->fdebug = fdebug;
+
+  out_dma_idle = dma_busy ? 0 : out_dma_idle + 1;
+
+  if (out_dma_idle == 2)
+  {
+    count_event(HEALTH_OUT_DMA_STOP, now);
+#ifdef HEALTH_AUTO_RESTART
+    restart_output = true; // from the main loop, not from the IRQ
+#endif
+  }
+}
+
+void health_start()
+{
+  if (health_alarm < 0)
+    health_alarm = hardware_alarm_claim_unused(true);
+
+  hw_set_bits(&timer_hw->inte, 1u << health_alarm);
+  irq_set_exclusive_handler(TIMER_IRQ_0 + health_alarm, health_poll);
+  irq_set_priority(TIMER_IRQ_0 + health_alarm, PICO_LOWEST_IRQ_PRIORITY);
+  irq_set_enabled(TIMER_IRQ_0 + health_alarm, true);
+  timer_hw->alarm[health_alarm] = timer_hw->timerawl + HEALTH_POLL_US;
+}
+
+// restart of a stopped output chain found by the poll, called from the main loop
+void health_update()
+{
+#ifdef HEALTH_AUTO_RESTART
+  if (!restart_output)
+    return;
+
+  stop_video_output();
+  start_video_output(active_video_output);
+  set_capture_frequency(settings.frequency);
+  out_dma_idle = 0;
+  restart_output = false;
+#endif
+}
+
+void health_reset()
+{
+  for (int i = 0; i < HEALTH_EVENT_COUNT; i++)
+  {
+    health_events[i].count = 0;
+    health_events[i].last_time = 0;
+  }
+}
\ No newline at end of file
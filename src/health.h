@@ -0,0 +1,23 @@
+#pragma once
+
+typedef enum health_event_id_t
+{
+  HEALTH_CAP_OVERFLOW, // capture RX FIFO full when the state machine pushed (DMA too late)
+  HEALTH_CAP_DMA_STOP, // capture DMA chain not running
+  HEALTH_OUT_UNDERRUN, // output TX FIFO empty when the state machine pulled (late line)
+  HEALTH_OUT_OVERRUN,  // output TX FIFO written while full
+  HEALTH_OUT_DMA_STOP, // output DMA chain not running
+  HEALTH_EVENT_COUNT,
+} health_event_id_t;
+
+typedef struct health_event_t
+{
+  uint32_t count;
+  uint32_t last_time; // microseconds since reset
+} health_event_t;
+
+extern health_event_t health_events[];
+
+void health_start();
+void health_update();
+void health_reset();
\ No newline at end of file
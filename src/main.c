@@ -5,6 +5,7 @@
 #include "hardware/vreg.h"
 
 #include "g_config.h"
+#include "health.h"
 #include "rgb_capture.h"
 #include "settings.h"
 #include "v_buf.h"
@@ -19,13 +20,18 @@
 #endif
 
 #ifdef SERIAL_MENU_ENABLE
+#include "frame_grab.h"
 #include "serial_menu.h"
+#include "telemetry.h"
 #endif
 
 #define PIN_LED (25u)
 
 settings_t settings;
 
+// end of every boot phase in microseconds since reset
+volatile uint32_t boot_time[BOOT_PHASE_COUNT];
+
 volatile bool start_core0 = false;
 
 volatile bool stop_core1 = false;
@@ -37,40 +43,57 @@ volatile bool capture_active = false;
 void setup()
 {
   vreg_set_voltage(VREG_VOLTAGE_1_25);
-  sleep_ms(100);
+  // the regulator settles well within this time, the system clock is raised in start_video_output()
+  sleep_ms(10);
+  boot_time[BOOT_VREG] = time_us_32();
 
 #ifdef SERIAL_MENU_ENABLE
   stdio_init_all();
 #endif
+  boot_time[BOOT_SERIAL] = time_us_32();
 
   load_settings(&settings);
 #ifdef VIDEO_OUTPUT_AUTO_DETECT
   settings.video_out_type = detect_video_output_type();
   check_settings(&settings);
 #endif
+  boot_time[BOOT_SETTINGS] = time_us_32();
+
+  // the monitor starts to sync before the welcome screen is drawn, the buffers are black until then
   set_buffering_mode(settings.buffering_mode);
-  draw_welcome_screen(*(video_modes[settings.video_out_mode]));
   set_scanlines_mode();
   start_video_output(settings.video_out_type);
+  boot_time[BOOT_OUTPUT] = time_us_32();
+
+  draw_welcome_screen(*(video_modes[settings.video_out_mode]));
+  boot_time[BOOT_WELCOME] = time_us_32();
 
 #ifdef OSD_ENABLE
   osd_init();
 #endif
 
+  health_start();
   start_core0 = true;
 
 #ifdef SERIAL_MENU_ENABLE
   printf("  Starting...\n\n");
+  print_boot_time();
 #endif
 }
 
 void loop()
 {
+  update_video_output();
+  health_update();
+
 #ifdef OSD_ENABLE
   osd_update();
 #endif
 
 #ifdef SERIAL_MENU_ENABLE
+  telemetry_update();
+  frame_grab_update();
+
 #ifdef OSD_ENABLE
   if (!osd_state.visible)
 #endif
@@ -93,12 +116,11 @@ void __attribute__((weak)) setup1()
 #endif
 
   start_capture();
+  boot_time[BOOT_CAPTURE] = time_us_32();
 }
 
 void __attribute__((weak)) __not_in_flash_func(loop1())
 {
-  uint32_t frame_count_tmp1 = frame_count;
-
 #ifdef OSD_FF_ENABLE
   if (ff_osd_needs_i2c_init)
   {
@@ -106,14 +128,16 @@ void __attribute__((weak)) __not_in_flash_func(loop1())
     ff_osd_needs_i2c_init = false;
   }
 
-  //  Call osd_process frequently to keep up with I2C data
+  // sleep until the I2C handler reports a complete transaction (it sends an event), the rest of the loop runs every 100 ms
   if (settings.ff_osd_config.enabled)
   {
-    for (int i = 0; i < 100; i++)
+    absolute_time_t until = make_timeout_time_ms(100);
+
+    do
     {
-      ff_osd_i2c_process();
-      sleep_ms(1);
-    }
+      if (ff_osd_i2c_pending())
+        ff_osd_i2c_process();
+    } while (!best_effort_wfe_or_timeout(until));
   }
   else
     sleep_ms(100);
@@ -121,20 +145,11 @@ void __attribute__((weak)) __not_in_flash_func(loop1())
   sleep_ms(100);
 #endif
 
+  // signal loss and recovery are handled by the sync watchdog of the capture, this only follows it
   if (frame_count > 1)
   {
+    capture_active = !no_signal;
     gpio_put(PIN_LED, (frame_count & 0x20) && capture_active);
-
-    if (frame_count == frame_count_tmp1)
-    {
-      if (capture_active)
-      {
-        capture_active = false;
-        draw_no_signal(*(video_modes[settings.video_out_mode]));
-      }
-    }
-    else if (!capture_active)
-      capture_active = true;
   }
 
   if (restart_capture)
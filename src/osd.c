@@ -19,9 +19,8 @@
 #define REPEAT_DELAY_US 500000  // 500ms initial repeat delay
 #define REPEAT_RATE_US 100000   // 100ms repeat rate
 
-extern video_mode_t video_mode;
 extern int16_t h_visible_area;
-extern int16_t v_margin;
+extern int16_t v_display_lines;
 
 osd_state_t osd_state = {
     .enabled = false,
@@ -45,15 +44,170 @@ osd_mode_t osd_mode = {
     .full_width = false,
     .text_buffer_size = OSD_TEXT_BUFFER_SIZE};
 
-uint8_t osd_buffer[OSD_BUFFER_SIZE];
+#ifndef OSD_TEXT_COMPOSITE
+static uint8_t osd_buffer[OSD_BUFFER_SIZE];
+#endif
 char osd_text_buffer[OSD_TEXT_BUFFER_SIZE];
 uint8_t osd_text_colors[OSD_TEXT_BUFFER_SIZE];
 uint8_t osd_text_heights[OSD_ROWS];
+// One bit per text cell: changed since it was last rendered
+static uint32_t osd_text_dirty[(OSD_TEXT_BUFFER_SIZE + 31) / 32];
+// Set when an update is ready for the output, cleared by osd_vblank() once it is shown
+static volatile bool osd_swap_pending = false;
+
+// The output reads a published copy of the text (the compositor and the Scale2x OSD), a new one is switched in at the output vblank
+typedef struct
+{
+    char buffer[OSD_TEXT_BUFFER_SIZE];
+    uint8_t colors[OSD_TEXT_BUFFER_SIZE];
+    uint8_t heights[OSD_ROWS];
+} osd_text_copy_t;
+
+static osd_text_copy_t osd_text_copies[2];
+static osd_text_copy_t *volatile osd_text_shown = &osd_text_copies[0];
+#define OSD_SHOWN(field) (osd_text_shown->field)
 
 osd_buttons_t osd_buttons = {0};
 static bool osd_buttons_block_until_release = false;
 
 const uint8_t (*osd_font)[8] = osd_font_style_1;
+// The output ISR reads the font from RAM (no XIP access in the ISR), copied when the layout is set
+static uint8_t osd_font_ram[256][OSD_FONT_HEIGHT];
+
+// Text row of an OSD line (osd_mode.rows below the text), line becomes the line within the row
+// double-height rows take two text lines
+static inline uint8_t osd_line_row(uint16_t *line, uint8_t *height)
+{
+    uint8_t row = 0;
+
+    for (; row < osd_mode.rows; row++)
+    {
+        *height = OSD_SHOWN(heights)[row];
+        uint8_t lines = *height ? 2 * OSD_FONT_HEIGHT : OSD_FONT_HEIGHT;
+
+        if (*line < lines)
+            break;
+
+        *line -= lines;
+    }
+
+    return row;
+}
+
+// Spread a nibble to every other bit: bit i -> bit 2i, in RAM for the output ISR
+static uint8_t osd_spread[16] = {
+    0x00, 0x01, 0x04, 0x05, 0x10, 0x11, 0x14, 0x15,
+    0x40, 0x41, 0x44, 0x45, 0x50, 0x51, 0x54, 0x55};
+
+// Sub-row u of a glyph scaled to 16x16 with Scale2x (EPX), bit 15 = left sub-pixel
+// the bits of a row byte are handled at once, pixels outside the cell count as background
+static inline uint16_t osd_glyph_row_2x(const uint8_t *glyph, uint8_t u)
+{
+    uint8_t r = u >> 1;
+    uint8_t above = r > 0 ? glyph[r - 1] : 0;
+    uint8_t below = r < OSD_FONT_HEIGHT - 1 ? glyph[r + 1] : 0;
+    uint8_t p = glyph[r];
+    uint8_t n = (u & 1) ? below : above; // neighbour row on the side of the sub-row
+    uint8_t f = (u & 1) ? above : below; // the opposite one
+    uint8_t c = p >> 1;                  // left neighbours (bit 7 = left pixel)
+    uint8_t b = p << 1;                  // right neighbours
+
+    uint8_t left = ~(c ^ n) & (c ^ f) & (n ^ b);  // C==N, C!=F, N!=B: left sub-pixel takes N
+    uint8_t right = ~(n ^ b) & (n ^ c) & (b ^ f); // N==B, N!=C, B!=F: right sub-pixel takes B (= N)
+
+    left = (left & n) | (~left & p);
+    right = (right & n) | (~right & p);
+
+    return ((osd_spread[left >> 4] << 9) | (osd_spread[left & 0x0f] << 1)) |
+           ((osd_spread[right >> 4] << 8) | osd_spread[right & 0x0f]);
+}
+
+// Glyph rows of an OSD line at twice the resolution for outputs with a PIO clock of half a pixel (Scale2x modes)
+// half selects the upper or lower half-line, returns the number of cells (0 below the text)
+uint8_t __not_in_flash_func(osd_line_2x)(uint16_t line, uint8_t half, uint16_t *bits, uint8_t *colors)
+{
+    uint8_t height;
+    uint8_t row = osd_line_row(&line, &height);
+
+    if (row == osd_mode.rows)
+        return 0;
+
+    uint8_t u = ((line << 1) | half) >> height;
+    uint8_t columns = osd_mode.columns < OSD_LINE_COLUMNS ? osd_mode.columns : OSD_LINE_COLUMNS;
+    const uint8_t *text = (const uint8_t *)&OSD_SHOWN(buffer)[row * osd_mode.columns];
+
+    for (uint8_t col = 0; col < columns; col++)
+        bits[col] = osd_glyph_row_2x(osd_font_ram[text[col]], u);
+
+    memcpy(colors, &OSD_SHOWN(colors)[row * osd_mode.columns], columns);
+
+    return columns;
+}
+
+#ifdef OSD_TEXT_COMPOSITE
+// The output ISR composes OSD lines from the text buffer
+static uint32_t osd_line_strip[OSD_LINE_COLUMNS]; // 8 packed pixels per cell
+static uint16_t osd_line_strip_y = 0xffff;        // OSD line in the strip
+// Glyph nibble (bit 3 = left pixel) -> mask of the fg pixels, low nibble = left pixel
+static uint16_t osd_nibble_mask[16] = {
+    0x0000, 0xf000, 0x0f00, 0xff00, 0x00f0, 0xf0f0, 0x0ff0, 0xfff0,
+    0x000f, 0xf00f, 0x0f0f, 0xff0f, 0x00ff, 0xf0ff, 0x0fff, 0xffff};
+
+// Packed pixels of an OSD line, rebuilt only when the line changes (repeated output lines reuse it)
+const uint8_t *__not_in_flash_func(osd_line_pixels)(uint16_t line)
+{
+    if (line == osd_line_strip_y)
+        return (const uint8_t *)osd_line_strip;
+
+    osd_line_strip_y = line;
+
+    uint8_t height;
+    uint8_t row = osd_line_row(&line, &height);
+    uint8_t columns = osd_mode.columns;
+
+    if (row == osd_mode.rows)
+    {
+        memset(osd_line_strip, OSD_COLOR_BACKGROUND * 0x11, columns * sizeof(uint32_t));
+        return (const uint8_t *)osd_line_strip;
+    }
+
+    uint8_t glyph_row = height ? line / 2 : line;
+    const uint8_t *text = (const uint8_t *)&OSD_SHOWN(buffer)[row * columns];
+    const uint8_t *colors = &OSD_SHOWN(colors)[row * columns];
+
+    for (uint8_t col = 0; col < columns; col++)
+    {
+        uint8_t bits = osd_font_ram[text[col]][glyph_row];
+        uint32_t mask = osd_nibble_mask[bits >> 4] | ((uint32_t)osd_nibble_mask[bits & 0x0f] << 16);
+        uint32_t fg = (colors[col] >> 4) * 0x11111111u;
+        uint32_t bg = (colors[col] & 0x0f) * 0x11111111u;
+
+        osd_line_strip[col] = bg ^ ((fg ^ bg) & mask);
+    }
+
+    return (const uint8_t *)osd_line_strip;
+}
+#else
+// The output reads the OSD through line pointers: a row with changed cells is drawn into a free block
+// and its lines are switched over at the output vblank, the block it leaves becomes free
+// free blocks are carved in single-height rows, adjacent ones are merged for a double-height row
+#define OSD_SPARE_LINES (2 * OSD_FONT_HEIGHT)
+
+typedef struct
+{
+    uint8_t *pixels;
+    uint8_t lines; // capacity
+} osd_block_t;
+
+const uint8_t *osd_lines[OSD_HEIGHT];
+static uint8_t osd_spare_buffer[OSD_WIDTH / 2 * OSD_SPARE_LINES];
+static osd_block_t osd_row_block[OSD_ROWS];  // shown storage of every text row
+static osd_block_t osd_next_block[OSD_ROWS]; // redrawn rows waiting for the vblank
+static osd_block_t osd_free_block[2 * OSD_ROWS + 2]; // every single-height row of the buffer and the spare
+static uint8_t osd_free_count;
+static uint8_t osd_row_y[OSD_ROWS];     // first line of every row
+static uint8_t osd_row_lines[OSD_ROWS]; // visible lines of every row
+static bool osd_rows_reset;              // rows moved: the next render draws in place
 
 static void osd_clear_buffer()
 { // Fill with background color (2 pixels per byte)
@@ -61,6 +215,140 @@ static void osd_clear_buffer()
     memset(osd_buffer, bg_color_pair, OSD_BUFFER_SIZE);
 }
 
+// Rows back in the pixel buffer in display order, free blocks from the unused end of it and the spare buffer
+static void osd_reset_rows()
+{
+    uint16_t bytes_per_line = osd_mode.width / 2;
+    uint16_t y = 0;
+
+    osd_swap_pending = false;
+
+    for (uint8_t row = 0; row < osd_mode.rows; row++)
+    {
+        uint8_t lines = osd_text_heights[row] ? 2 * OSD_FONT_HEIGHT : OSD_FONT_HEIGHT;
+
+        if (y + lines > osd_mode.height)
+            lines = osd_mode.height - y;
+
+        osd_row_y[row] = y;
+        osd_row_lines[row] = lines;
+        osd_row_block[row] = (osd_block_t){&osd_buffer[y * bytes_per_line], lines};
+        osd_next_block[row].pixels = NULL;
+
+        for (uint8_t i = 0; i < lines; i++)
+            osd_lines[y + i] = &osd_buffer[(y + i) * bytes_per_line];
+
+        y += lines;
+    }
+
+    osd_free_count = 0;
+
+    if (bytes_per_line > 0)
+    {
+        for (; (y + OSD_FONT_HEIGHT) * bytes_per_line <= OSD_BUFFER_SIZE && osd_free_count < OSD_ROWS; y += OSD_FONT_HEIGHT)
+            osd_free_block[osd_free_count++] = (osd_block_t){&osd_buffer[y * bytes_per_line], OSD_FONT_HEIGHT};
+
+        // two single-height rows from the spare buffer: a cursor move redraws two rows of a full-size menu
+        uint16_t lines = sizeof(osd_spare_buffer) / bytes_per_line;
+
+        for (y = 0; y + OSD_FONT_HEIGHT <= lines && y < OSD_SPARE_LINES; y += OSD_FONT_HEIGHT)
+            osd_free_block[osd_free_count++] = (osd_block_t){&osd_spare_buffer[y * bytes_per_line], OSD_FONT_HEIGHT};
+    }
+
+    osd_rows_reset = true;
+    osd_text_invalidate();
+}
+
+// Join two free blocks that follow each other in the same buffer, false if there are none
+static bool osd_merge_blocks()
+{
+    uint16_t bytes_per_line = osd_mode.width / 2;
+
+    for (uint8_t i = 0; i < osd_free_count; i++)
+        for (uint8_t j = 0; j < osd_free_count; j++)
+        {
+            osd_block_t *a = &osd_free_block[i];
+            osd_block_t *b = &osd_free_block[j];
+
+            if (a->pixels + a->lines * bytes_per_line != b->pixels || b->pixels == osd_spare_buffer || b->pixels == osd_buffer)
+                continue;
+
+            a->lines += b->lines;
+            *b = osd_free_block[--osd_free_count];
+
+            return true;
+        }
+
+    return false;
+}
+
+// A free block for the next version of a row, the lines it does not need stay free
+static bool osd_take_block(uint8_t row)
+{
+    uint8_t lines = osd_row_lines[row];
+
+    do
+    {
+        for (uint8_t i = 0; i < osd_free_count; i++)
+        {
+            osd_block_t *block = &osd_free_block[i];
+
+            if (block->lines < lines)
+                continue;
+
+            osd_next_block[row] = (osd_block_t){block->pixels, lines};
+
+            if (block->lines > lines)
+            {
+                block->pixels += lines * (osd_mode.width / 2);
+                block->lines -= lines;
+            }
+            else
+                *block = osd_free_block[--osd_free_count];
+
+            return true;
+        }
+    } while (osd_merge_blocks());
+
+    return false;
+}
+
+// Switch the lines of the redrawn rows over to their new blocks, called by the output ISR at the vblank
+void __not_in_flash_func(osd_vblank)()
+{
+    if (!osd_swap_pending)
+        return;
+
+    uint16_t bytes_per_line = osd_mode.width / 2;
+
+    for (uint8_t row = 0; row < osd_mode.rows; row++)
+    {
+        osd_block_t next = osd_next_block[row];
+
+        if (next.pixels == NULL)
+            continue;
+
+        for (uint8_t i = 0; i < osd_row_lines[row]; i++)
+            osd_lines[osd_row_y[row] + i] = &next.pixels[i * bytes_per_line];
+
+        osd_free_block[osd_free_count++] = osd_row_block[row];
+        osd_row_block[row] = next;
+        osd_next_block[row].pixels = NULL;
+    }
+
+    osd_text_shown = (osd_text_shown == &osd_text_copies[0]) ? &osd_text_copies[1] : &osd_text_copies[0];
+    osd_swap_pending = false;
+}
+#endif
+
+static void osd_load_font()
+{
+    memcpy(osd_font_ram, osd_font, sizeof(osd_font_ram));
+#ifdef OSD_TEXT_COMPOSITE
+    osd_line_strip_y = 0xffff;
+#endif
+}
+
 static void osd_draw_border()
 {
     if (!osd_mode.border_enabled)
@@ -96,10 +384,17 @@ void osd_init()
     osd_state.enabled = true;
     osd_state.needs_redraw = true;
     osd_state.text_updated = true;
+    osd_state.layout_changed = true;
     // Initialize text buffer
     osd_clear_text_buffer();
+    osd_load_font();
+#ifdef OSD_TEXT_COMPOSITE
+    osd_text_invalidate();
+#else
     // Clear overlay buffer
     osd_clear_buffer();
+    osd_reset_rows();
+#endif
 
     // Initialize buttons
     osd_buttons_init();
@@ -121,7 +416,6 @@ void osd_set_position()
     }
 
     // Vertical: height must not exceed available vertical display lines
-    uint16_t v_display_lines = (video_mode.v_visible_area - 2 * v_margin) / video_mode.div;
     if (osd_mode.height > v_display_lines)
     {
         osd_mode.height = v_display_lines;
@@ -132,6 +426,11 @@ void osd_set_position()
     if (osd_mode.rows > OSD_ROWS)
         osd_mode.rows = OSD_ROWS;
 
+#ifdef OSD_TEXT_COMPOSITE
+    if (osd_mode.columns > OSD_LINE_COLUMNS)
+        osd_mode.columns = OSD_LINE_COLUMNS;
+#endif
+
     if (osd_mode.columns > 0 && osd_mode.columns * osd_mode.rows > OSD_TEXT_BUFFER_SIZE)
         osd_mode.rows = OSD_TEXT_BUFFER_SIZE / osd_mode.columns;
 
@@ -200,6 +499,16 @@ void osd_set_position()
 
     if (osd_mode.end_y > v_display_lines)
         osd_mode.end_y = v_display_lines;
+
+    // The font may have changed with the layout
+    osd_load_font();
+#ifdef OSD_TEXT_COMPOSITE
+    osd_text_invalidate();
+#else
+    // Cell positions in the pixel buffer have moved
+    osd_reset_rows();
+#endif
+    osd_state.layout_changed = true;
 }
 
 void osd_show()
@@ -226,6 +535,36 @@ void osd_update_activity()
     osd_state.last_activity_time = time_us_64();
 }
 
+void osd_text_invalidate()
+{
+    memset(osd_text_dirty, 0xff, sizeof(osd_text_dirty));
+}
+
+// Store a cell, mark it dirty only when it changes
+static inline void osd_text_put(uint16_t pos, uint8_t c, uint8_t packed_color)
+{
+    if ((uint8_t)osd_text_buffer[pos] == c && osd_text_colors[pos] == packed_color)
+        return;
+
+    osd_text_buffer[pos] = c;
+    osd_text_colors[pos] = packed_color;
+    osd_text_dirty[pos / 32] |= 1u << (pos % 32);
+}
+
+// A height change moves every row below
+static void osd_text_set_height(uint8_t row, uint8_t height)
+{
+    if (osd_text_heights[row] == height)
+        return;
+
+    osd_text_heights[row] = height;
+#ifdef OSD_TEXT_COMPOSITE
+    osd_text_invalidate();
+#else
+    osd_reset_rows();
+#endif
+}
+
 void osd_clear_text_buffer()
 { // Clear text buffer but preserve border positions
     uint8_t default_color = (OSD_COLOR_TEXT << 4) | OSD_COLOR_BACKGROUND;
@@ -240,11 +579,10 @@ void osd_clear_text_buffer()
                 (row == 0 || row == osd_mode.rows - 1 || col == 0 || col == osd_mode.columns - 1))
                 continue;
 
-            osd_text_buffer[pos] = ' ';
-            osd_text_colors[pos] = default_color;
+            osd_text_put(pos, ' ', default_color);
         }
 
-        osd_text_heights[row] = 0;
+        osd_text_set_height(row, 0);
     }
 }
 
@@ -253,9 +591,7 @@ void osd_text_set_char(uint8_t row, uint8_t col, uint8_t c, uint8_t fg_color, ui
     if (row >= osd_mode.rows || col >= osd_mode.columns)
         return;
 
-    uint16_t pos = row * osd_mode.columns + col;
-    osd_text_buffer[pos] = c;
-    osd_text_colors[pos] = (fg_color << 4) | bg_color;
+    osd_text_put(row * osd_mode.columns + col, c, (fg_color << 4) | bg_color);
 }
 
 void osd_text_print(uint8_t row, uint8_t col, const char *str, uint8_t fg_color, uint8_t bg_color, uint8_t height)
@@ -263,7 +599,7 @@ void osd_text_print(uint8_t row, uint8_t col, const char *str, uint8_t fg_color,
     if (row >= osd_mode.rows)
         return;
     // Set height for this row
-    osd_text_heights[row] = height;
+    osd_text_set_height(row, height);
 
     uint16_t row_start = row * osd_mode.columns;
     uint16_t pos = row_start + col;
@@ -275,8 +611,7 @@ void osd_text_print(uint8_t row, uint8_t col, const char *str, uint8_t fg_color,
 
     for (uint8_t i = start_col; i < col; i++)
     {
-        osd_text_buffer[row_start + i] = ' ';
-        osd_text_colors[row_start + i] = packed_color;
+        osd_text_put(row_start + i, ' ', packed_color);
     }
 
     uint8_t i;
@@ -290,14 +625,12 @@ void osd_text_print(uint8_t row, uint8_t col, const char *str, uint8_t fg_color,
 
     for (i = 0; i < effective_max_len && str[i] != '\0'; i++)
     {
-        osd_text_buffer[pos + i] = str[i];
-        osd_text_colors[pos + i] = packed_color;
+        osd_text_put(pos + i, str[i], packed_color);
     }
     // Pad with spaces to fill the rest of the row
     for (; i < effective_max_len; i++)
     {
-        osd_text_buffer[pos + i] = ' ';
-        osd_text_colors[pos + i] = packed_color;
+        osd_text_put(pos + i, ' ', packed_color);
     }
 }
 
@@ -334,73 +667,190 @@ void osd_text_printf(uint8_t row, uint8_t col, uint8_t fg_color, uint8_t bg_colo
     osd_text_print(row, col, temp, fg_color, bg_color, height);
 }
 
-void osd_render_text_to_buffer()
-{                          // Render text buffer to pixel buffer
-    uint16_t y_offset = 0; // Accumulated Y offset for double-height rows
+static inline bool osd_text_is_dirty(uint16_t pos)
+{
+    return osd_text_dirty[pos / 32] & (1u << (pos % 32));
+}
 
-    for (uint8_t row = 0; row < osd_mode.rows; row++)
+// Copy the text into the copy the output does not read, osd_vblank() switches it in
+static void osd_publish_text()
+{
+    uint16_t count = osd_mode.columns * osd_mode.rows;
+    osd_text_copy_t *next = (osd_text_shown == &osd_text_copies[0]) ? &osd_text_copies[1] : &osd_text_copies[0];
+
+    memcpy(next->buffer, osd_text_buffer, count);
+    memcpy(next->colors, osd_text_colors, count);
+    memcpy(next->heights, osd_text_heights, sizeof(next->heights));
+}
+
+#ifdef OSD_TEXT_COMPOSITE
+bool osd_render_text_to_buffer()
+{ // Publish the text for the output, it is switched in at the next vblank
+    if (osd_swap_pending)
+        return false;
+
+    uint16_t count = osd_mode.columns * osd_mode.rows;
+    uint16_t pos = 0;
+
+    while (pos < count && !osd_text_is_dirty(pos))
+        pos++;
+
+    if (pos == count)
+        return true;
+
+    osd_publish_text();
+    memset(osd_text_dirty, 0, sizeof(osd_text_dirty));
+    osd_swap_pending = true;
+
+    return true;
+}
+
+void __not_in_flash_func(osd_vblank)()
+{
+    if (!osd_swap_pending)
+        return;
+
+    osd_text_shown = (osd_text_shown == &osd_text_copies[0]) ? &osd_text_copies[1] : &osd_text_copies[0];
+    osd_line_strip_y = 0xffff;
+    osd_swap_pending = false;
+}
+#else
+// Glyph nibble (bit 3 = left pixel) -> two packed bytes (low nibble = left pixel) for one fg/bg pair
+static uint16_t osd_nibble_lut[16];
+static int16_t osd_nibble_lut_colors = -1;
+
+static void osd_build_nibble_lut(uint8_t fg_color, uint8_t bg_color)
+{
+    int16_t colors = (fg_color << 4) | bg_color;
+
+    if (colors == osd_nibble_lut_colors)
+        return;
+
+    osd_nibble_lut_colors = colors;
+
+    for (uint8_t n = 0; n < 16; n++)
     {
-        uint8_t height = osd_text_heights[row];
+        uint16_t bytes = 0;
 
-        for (uint8_t col = 0; col < osd_mode.columns; col++)
-        {
-            uint16_t pos = row * osd_mode.columns + col;
-            uint8_t c = (uint8_t)osd_text_buffer[pos];
-            uint8_t packed_color = osd_text_colors[pos];
-            uint8_t fg_color = (packed_color >> 4) & 0x0F;
-            uint8_t bg_color = packed_color & 0x0F;
+        for (uint8_t bit = 0; bit < 4; bit++)
+            bytes |= ((n & (0x8 >> bit)) ? fg_color : bg_color) << (bit * 4);
 
-            uint16_t x = col * OSD_FONT_WIDTH;
-            uint16_t y = row * OSD_FONT_HEIGHT + y_offset;
+        osd_nibble_lut[n] = bytes;
+    }
+}
 
-            osd_draw_char(osd_buffer, osd_mode.width, x, y, c, fg_color, bg_color, height);
-        }
-        // Add extra vertical space for double-height rows
-        if (height)
-            y_offset += OSD_FONT_HEIGHT;
+// Draw a glyph into a cell, whole bytes with two glyph pixels each
+static void osd_draw_glyph(uint8_t *dst, uint16_t bytes_per_line, uint8_t lines,
+                           const uint8_t *char_data, uint8_t fg_color, uint8_t bg_color, uint8_t height_shift)
+{
+    osd_build_nibble_lut(fg_color & 0x0F, bg_color & 0x0F);
+
+    for (uint8_t i = 0; i < lines; i++, dst += bytes_per_line)
+    {
+        uint8_t line = char_data[i >> height_shift];
+        uint16_t left = osd_nibble_lut[line >> 4];
+        uint16_t right = osd_nibble_lut[line & 0x0F];
+
+        dst[0] = left;
+        dst[1] = left >> 8;
+        dst[2] = right;
+        dst[3] = right >> 8;
     }
 }
 
-void osd_draw_char(uint8_t *buffer, uint16_t buf_width, uint16_t x, uint16_t y,
-                   uint8_t c, uint8_t fg_color, uint8_t bg_color, uint8_t height)
+// Draw the changed cells of a row into its row storage
+static void osd_render_row(uint8_t row, uint8_t *pixels)
 {
-    const uint8_t *char_data = osd_font[c];
-    uint8_t height_multiplier = height ? 2 : 1;
+    uint8_t height_shift = osd_text_heights[row] ? 1 : 0;
+    uint8_t lines = OSD_FONT_HEIGHT << height_shift;
+    uint16_t bytes_per_line = osd_mode.width / 2;
+
+    if (lines > osd_row_lines[row])
+        lines = osd_row_lines[row];
 
-    for (int row = 0; row < OSD_FONT_HEIGHT; row++)
+    for (uint8_t col = 0; col < osd_mode.columns; col++)
     {
-        uint8_t line = char_data[row];
+        uint16_t pos = row * osd_mode.columns + col;
 
-        for (int pixel_row = 0; pixel_row < height_multiplier; pixel_row++)
-        {
-            uint16_t py = y + row * height_multiplier + pixel_row;
+        if (!osd_text_is_dirty(pos))
+            continue;
 
-            for (int col = 0; col < OSD_FONT_WIDTH; col++)
+        osd_text_dirty[pos / 32] &= ~(1u << (pos % 32));
+
+        uint8_t packed_color = osd_text_colors[pos];
+
+        osd_draw_glyph(&pixels[col * (OSD_FONT_WIDTH / 2)], bytes_per_line, lines,
+                       osd_font[(uint8_t)osd_text_buffer[pos]], packed_color >> 4, packed_color & 0x0F, height_shift);
+    }
+}
+
+bool osd_render_text_to_buffer()
+{ // Render the changed cells of the text buffer to the pixel buffer
+    if (osd_swap_pending)
+        return false;
+
+    uint16_t changed = 0; // rows with changed cells
+
+    for (uint8_t row = 0; row < osd_mode.rows; row++)
+    {
+        uint16_t pos = row * osd_mode.columns;
+
+        for (uint8_t col = 0; col < osd_mode.columns; col++, pos++)
+            if (osd_text_is_dirty(pos))
             {
-                uint16_t px = x + col;
-                // Check bounds
-                if (px >= buf_width || py >= osd_mode.height)
-                    continue;
-                // Calculate buffer position (2 pixels per byte)
-                int buffer_offset = py * (buf_width / 2) + (px / 2);
+                changed |= 1u << row;
+                break;
+            }
+    }
 
-                if (buffer_offset >= osd_mode.buffer_size)
-                    continue;
-                // Determine pixel color
-                uint8_t pixel_color = (line & (0x80 >> col)) ? fg_color : bg_color;
-                // Set pixel in buffer (2 pixels per byte)
-                if (px & 1)
-                { // Odd pixel (upper 4 bits)
-                    buffer[buffer_offset] = (buffer[buffer_offset] & 0x0F) | (pixel_color << 4);
-                }
-                else
-                { // Even pixel (lower 4 bits)
-                    buffer[buffer_offset] = (buffer[buffer_offset] & 0xF0) | (pixel_color & 0x0F);
-                }
+    if (!changed)
+        return true;
+
+    // A shown OSD gets the changed rows in free blocks, without enough of them everything is drawn in place
+    bool in_place = !osd_state.visible || osd_rows_reset;
+
+    for (uint8_t row = 0; row < osd_mode.rows && !in_place; row++)
+    {
+        if (!(changed & (1u << row)) || osd_row_lines[row] == 0 || osd_take_block(row))
+            continue;
+
+        for (uint8_t r = 0; r < row; r++)
+            if (osd_next_block[r].pixels != NULL)
+            {
+                osd_free_block[osd_free_count++] = osd_next_block[r];
+                osd_next_block[r].pixels = NULL;
             }
+
+        in_place = true;
+    }
+
+    uint16_t bytes_per_line = osd_mode.width / 2;
+
+    for (uint8_t row = 0; row < osd_mode.rows; row++)
+    {
+        if (!(changed & (1u << row)))
+            continue;
+
+        uint8_t *pixels = osd_row_block[row].pixels;
+
+        if (!in_place && osd_next_block[row].pixels != NULL)
+        { // the unchanged cells come from the shown version
+            memcpy(osd_next_block[row].pixels, pixels, osd_row_lines[row] * bytes_per_line);
+            pixels = osd_next_block[row].pixels;
         }
+
+        osd_render_row(row, pixels);
     }
+
+    osd_rows_reset = false;
+
+    // rows drawn in place are shown already, the text for the Scale2x OSD still waits for the vblank
+    osd_publish_text();
+    osd_swap_pending = true;
+
+    return true;
 }
+#endif
 
 void osd_update()
 {
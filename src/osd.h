@@ -9,6 +9,7 @@
 #define OSD_COLUMNS (OSD_WIDTH / OSD_FONT_WIDTH)
 #define OSD_ROWS (OSD_HEIGHT / OSD_FONT_HEIGHT)
 #define OSD_TEXT_BUFFER_SIZE (OSD_COLUMNS * OSD_ROWS)
+#define OSD_LINE_COLUMNS 40 // Widest text line: a 40-column FF display
 
 #define OSD_COLOR_BACKGROUND 0x0 // Black
 #define OSD_COLOR_TEXT 0xB       // Bright cyan
@@ -43,6 +44,7 @@ typedef struct
     bool visible;
     bool needs_redraw;
     bool text_updated;           // True when text buffer needs to be rendered to OSD buffer
+    bool layout_changed;         // Set by osd_set_position(), the FF OSD reapplies its geometry
     bool menu_active;            // True when OSD menu owns the display
     uint64_t last_activity_time; // Time of last user interaction
     uint64_t show_time;          // Time when OSD was shown
@@ -65,7 +67,6 @@ extern osd_state_t osd_state;
 extern osd_mode_t osd_mode;
 extern osd_buttons_t osd_buttons;
 extern const uint8_t (*osd_font)[8];
-extern uint8_t osd_buffer[OSD_BUFFER_SIZE];
 extern char osd_text_buffer[OSD_TEXT_BUFFER_SIZE];    // Text buffer for content
 extern uint8_t osd_text_colors[OSD_TEXT_BUFFER_SIZE]; // High nibble: fg_color, Low nibble: bg_color
 extern uint8_t osd_text_heights[OSD_ROWS];            // 0 = normal height, 1 = double height (per row)
@@ -77,11 +78,25 @@ void osd_show();
 void osd_hide();
 void osd_update_activity();
 
-void osd_clear_text_buffer();
-void osd_render_text_to_buffer(); // Render text buffer to OSD pixel buffer
+#ifdef OSD_TEXT_COMPOSITE
+const uint8_t *osd_line_pixels(uint16_t line); // Composed from the text buffer by the output ISR
+#else
+extern const uint8_t *osd_lines[OSD_HEIGHT]; // Shown version of every line, switched by osd_vblank()
+
+// Packed pixels (low nibble = left pixel) of an OSD line
+static inline const uint8_t *osd_line_pixels(uint16_t line)
+{
+    return osd_lines[line];
+}
+#endif
+void osd_vblank(); // Output ISR at the start of a frame: show the last update
 
-void osd_draw_char(uint8_t *buffer, uint16_t buf_width, uint16_t x, uint16_t y,
-                   uint8_t c, uint8_t fg_color, uint8_t bg_color, uint8_t height);
+// Glyph rows of an OSD line scaled to 16x16 per cell (bit 15 = left sub-pixel) and the packed cell colours
+uint8_t osd_line_2x(uint16_t line, uint8_t half, uint16_t *bits, uint8_t *colors);
+
+void osd_clear_text_buffer();
+bool osd_render_text_to_buffer(); // Render changed cells of the text buffer to OSD pixel buffer, false while the last update waits for the vblank
+void osd_text_invalidate();       // Render every cell on the next osd_render_text_to_buffer()
 
 void osd_text_print(uint8_t row, uint8_t col, const char *str, uint8_t fg_color, uint8_t bg_color, uint8_t height);
 void osd_text_print_centered(uint8_t row, const char *str, uint8_t fg_color, uint8_t bg_color, uint8_t height);
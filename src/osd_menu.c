@@ -1,11 +1,14 @@
+#include "hardware/clocks.h"
 #include "hardware/timer.h"
 
 #include "g_config.h"
 #include "osd_menu.h"
 #include "font.h"
+#include "health.h"
 #include "osd.h"
 #include "rgb_capture.h"
 #include "settings.h"
+#include "v_buf.h"
 #include "video_output.h"
 
 #ifdef OSD_FF_ENABLE
@@ -21,17 +24,24 @@ static const uint8_t mask_bit_positions[] = {F_PIN, HS_PIN, VS_PIN, I_PIN, R_PIN
 #define MAIN_ITEM_IMAGE_ADJ 2
 #ifdef OSD_FF_ENABLE
 #define MAIN_ITEM_FF_OSD 3
+#define MAIN_ITEM_STATS 4
+#define MAIN_ITEM_ABOUT 5
+#define MAIN_ITEM_SAVE 6
+#define MAIN_ITEM_EXIT 7
+#define MAIN_ITEM_COUNT 8
+#else
+#define MAIN_ITEM_STATS 3
 #define MAIN_ITEM_ABOUT 4
 #define MAIN_ITEM_SAVE 5
 #define MAIN_ITEM_EXIT 6
 #define MAIN_ITEM_COUNT 7
-#else
-#define MAIN_ITEM_ABOUT 3
-#define MAIN_ITEM_SAVE 4
-#define MAIN_ITEM_EXIT 5
-#define MAIN_ITEM_COUNT 6
 #endif
 
+// Statistics page: value rows, refresh period
+#define STATS_ROW_COUNT 7
+#define STATS_VALUE_COL 12
+#define STATS_REFRESH_US 1000000
+
 extern settings_t settings;
 extern video_out_type_t active_video_output;
 extern volatile bool restart_capture;
@@ -42,6 +52,26 @@ osd_menu_state_t osd_menu_state = {
 
 osd_menu_nav_t osd_menu = {0};
 
+// Statistics page: counters at the last refresh and the value rows on screen
+typedef struct stats_counters_t
+{
+    uint32_t time;
+    uint32_t in_frames;
+    uint32_t out_frames;
+    uint32_t samples;
+    uint32_t cap_cycles;
+    uint32_t out_cycles;
+    uint32_t dropped;
+    uint32_t repeated;
+    uint32_t i2c_bytes;
+} stats_counters_t;
+
+static stats_counters_t stats_prev;
+static char stats_text[STATS_ROW_COUNT][OSD_COLUMNS];
+
+static const char *const stats_labels[STATS_ROW_COUNT] = {
+    "INPUT", "OUTPUT", "PIXEL CLK", "DROP/REP", "ISR LOAD", "FIFO ERR", "I2C"};
+
 static void osd_menu_hide(void)
 {
     // Hide menu and block button input until all buttons are released.
@@ -97,12 +127,85 @@ static void osd_flush_render(void)
     }
 
     if (osd_state.text_updated)
-    {
-        osd_render_text_to_buffer();
-        osd_state.text_updated = false;
+    { // Retried on the next update while the last one is not shown yet
+        osd_state.text_updated = !osd_render_text_to_buffer();
     }
 }
 
+static void stats_read(stats_counters_t *c)
+{
+    c->time = time_us_32();
+    c->in_frames = frame_count;
+    c->out_frames = out_frame_count;
+    c->samples = cap_samples;
+    c->cap_cycles = cap_isr_cycles;
+    c->out_cycles = out_isr_cycles;
+    c->dropped = frames_dropped;
+    c->repeated = frames_repeated;
+#ifdef OSD_FF_ENABLE
+    c->i2c_bytes = ff_osd_i2c_bytes;
+#else
+    c->i2c_bytes = 0;
+#endif
+}
+
+// Take the baseline when the page is entered, values follow after one refresh period
+static void stats_start(void)
+{
+    stats_read(&stats_prev);
+
+    for (int i = 0; i < STATS_ROW_COUNT; i++)
+        strcpy(stats_text[i], "-");
+}
+
+// ISR load in percent of the period, SysTick counts system clock cycles
+static uint32_t stats_load(uint32_t cycles, uint32_t dt)
+{
+    return (uint64_t)cycles * 100000000 / ((uint64_t)clock_get_hz(clk_sys) * dt);
+}
+
+// Write a value row to the text buffer, only the cells that changed are drawn
+static void stats_print_cells(uint8_t row, const char *str)
+{
+    for (uint8_t col = STATS_VALUE_COL; col < osd_mode.columns - 1; col++)
+        osd_text_set_char(row, col, *str ? *str++ : ' ', OSD_COLOR_TEXT, OSD_COLOR_BACKGROUND);
+
+    osd_state.text_updated = true;
+}
+
+static void stats_update(void)
+{
+    stats_counters_t cur;
+
+    if (time_us_32() - stats_prev.time < STATS_REFRESH_US)
+        return;
+
+    stats_read(&cur);
+
+    uint32_t dt = cur.time - stats_prev.time;
+    // the capture frame counter restarts with the capture
+    uint32_t in_frames = cur.in_frames >= stats_prev.in_frames ? cur.in_frames - stats_prev.in_frames : cur.in_frames;
+    uint32_t in_rate = (uint64_t)in_frames * 10000000 / dt;
+    uint32_t out_rate = (uint64_t)(cur.out_frames - stats_prev.out_frames) * 10000000 / dt;
+    uint32_t pixel_khz = (uint64_t)(cur.samples - stats_prev.samples) * 1000 / dt;
+    uint32_t i2c_rate = (uint64_t)(cur.i2c_bytes - stats_prev.i2c_bytes) * 1000000 / dt;
+
+    snprintf(stats_text[0], OSD_COLUMNS, "%lu.%lu HZ", in_rate / 10, in_rate % 10);
+    snprintf(stats_text[1], OSD_COLUMNS, "%lu.%lu HZ", out_rate / 10, out_rate % 10);
+    snprintf(stats_text[2], OSD_COLUMNS, "%lu.%03lu MHZ", pixel_khz / 1000, pixel_khz % 1000);
+    snprintf(stats_text[3], OSD_COLUMNS, "%lu/%lu PER S", cur.dropped - stats_prev.dropped, cur.repeated - stats_prev.repeated);
+    snprintf(stats_text[4], OSD_COLUMNS, "C %lu%% O %lu%%", stats_load(cur.cap_cycles - stats_prev.cap_cycles, dt),
+             stats_load(cur.out_cycles - stats_prev.out_cycles, dt));
+    snprintf(stats_text[5], OSD_COLUMNS, "C %lu O %lu", health_events[HEALTH_CAP_OVERFLOW].count,
+             health_events[HEALTH_OUT_UNDERRUN].count + health_events[HEALTH_OUT_OVERRUN].count);
+    snprintf(stats_text[6], OSD_COLUMNS, "%lu B/S", i2c_rate);
+
+    stats_prev = cur;
+
+    for (int i = 0; i < STATS_ROW_COUNT; i++)
+        stats_print_cells(OSD_MENU_START_ROW + i, stats_text[i]);
+}
+
 void osd_menu_init()
 {
     memset(&osd_menu_state, 0, sizeof(osd_menu_state));
@@ -187,7 +290,8 @@ void osd_menu_update()
     {
         uint64_t current_time = time_us_64();
 
-        if ((current_time - osd_state.last_activity_time) > OSD_MENU_TIMEOUT_US)
+        // the statistics page stays open until it is left
+        if (osd_menu.current_menu != MENU_TYPE_STATS && (current_time - osd_state.last_activity_time) > OSD_MENU_TIMEOUT_US)
         {
             osd_menu_hide();
             return;
@@ -200,15 +304,15 @@ void osd_menu_update()
         if (osd_menu.current_menu == MENU_TYPE_MAIN)
             max_items = MAIN_ITEM_COUNT - 1;
         else if (osd_menu.current_menu == MENU_TYPE_OUTPUT)
-            max_items = 3; // Output menu: 0-3 (4 items: mode, scanlines, buffering, back)
+            max_items = 6; // Output menu: 0-6 (7 items: mode, scanlines, buffering, scaling, blending, OSD background, back)
         else if (osd_menu.current_menu == MENU_TYPE_CAPTURE)
             max_items = 5; // Capture menu: 0-5 (6 items: freq, mode, divider, sync, mask, back) - divider always shown but dimmed for SELF
         else if (osd_menu.current_menu == MENU_TYPE_IMAGE_ADJUST)
             max_items = 4; // Image adjust menu: 0-4 (5 items: H-POS, V-POS, DELAY, RESET, BACK)
         else if (osd_menu.current_menu == MENU_TYPE_MASK)
             max_items = 7; // Mask menu: 0-7 (8 items: F, SSI, KSI, I, B, G, R, BACK)
-        else if (osd_menu.current_menu == MENU_TYPE_ABOUT)
-            max_items = 0; // About menu: 0 (1 item: BACK)
+        else if (osd_menu.current_menu == MENU_TYPE_ABOUT || osd_menu.current_menu == MENU_TYPE_STATS)
+            max_items = 0; // About and statistics pages: 0 (1 item: BACK)
 #ifdef MAIN_ITEM_FF_OSD
         else if (osd_menu.current_menu == MENU_TYPE_FF_OSD)
             max_items = 6; // FF OSD menu: 0-6 (7 items: ENABLE, PROTOCOL, ROWS, COLUMNS, H_POS, V_POS, BACK)
@@ -317,6 +421,11 @@ void osd_menu_update()
                     menu_changed = osd_menu_enter_submenu(MENU_TYPE_FF_OSD);
                 }
 #endif
+                else if (osd_menu_state.selected_item == MAIN_ITEM_STATS)
+                { // Statistics
+                    stats_start();
+                    menu_changed = osd_menu_enter_submenu(MENU_TYPE_STATS);
+                }
                 else if (osd_menu_state.selected_item == MAIN_ITEM_ABOUT)
                 { // About
                     menu_changed = osd_menu_enter_submenu(MENU_TYPE_ABOUT);
@@ -335,7 +444,7 @@ void osd_menu_update()
             }
             else if (osd_menu.current_menu == MENU_TYPE_OUTPUT)
             {                                // Output submenu selection
-                uint8_t back_item_index = 3; // 4 items (mode, scanlines, buffering, back)
+                uint8_t back_item_index = 6; // 7 items (mode, scanlines, buffering, scaling, blending, OSD background, back)
 
                 if (osd_menu_state.selected_item == back_item_index)
                 { // Back to Main
@@ -364,26 +473,50 @@ void osd_menu_update()
                     osd_state.needs_redraw = true;
                 }
                 else if (osd_menu_state.selected_item == 1)
-                { // Scanlines - toggle
-                    // Only allow toggle for VGA and when scanlines are supported
-                    bool scanlines_supported = false;
+                { // Scanlines - cycle OFF, ON and DIM, ON (black) is skipped where it is not supported
+                    bool scanlines_supported = true;
+                    bool black_supported = false;
 
                     if (settings.video_out_type == VGA)
                     {
 #ifdef SCANLINES_ENABLE_LOW_RES
-                        // When SCANLINES_ENABLE_LOW_RES is defined, scanlines are supported for all div values
-                        scanlines_supported = true;
+                        // When SCANLINES_ENABLE_LOW_RES is defined, black scanlines are supported for all div values
+                        black_supported = true;
 #else
-                        // When SCANLINES_ENABLE_LOW_RES is not defined, only support div 3 and 4
+                        // When SCANLINES_ENABLE_LOW_RES is not defined, black scanlines only for div 3 and 4
                         uint8_t div = video_modes[settings.video_out_mode]->div;
-                        scanlines_supported = (div == 3 || div == 4);
+                        black_supported = (div == 3 || div == 4);
 #endif
+                        // fractional scaler repeats lines unevenly, no scanlines
+                        if (settings.scaling_mode != SCALE_INTEGER)
+                            scanlines_supported = false;
                     }
 
                     if (scanlines_supported)
                     {
-                        settings.scanlines_mode = !settings.scanlines_mode;
+                        if (!settings.scanlines_mode)
+                        {
+                            settings.scanlines_mode = true;
+                            settings.scanlines_dim = !black_supported;
+                        }
+                        else if (!settings.scanlines_dim)
+                            settings.scanlines_dim = true;
+                        else
+                        {
+                            settings.scanlines_mode = false;
+                            settings.scanlines_dim = false;
+                        }
+
                         set_scanlines_mode();
+
+                        // DVI allocates the dimmed scanline buffer at start
+                        if (active_video_output == DVI && settings.video_out_type == DVI)
+                        {
+                            stop_video_output();
+                            start_video_output(active_video_output);
+                            set_capture_frequency(settings.frequency);
+                        }
+
                         osd_state.needs_redraw = true;
                     }
                 }
@@ -394,6 +527,47 @@ void osd_menu_update()
                     set_buffering_mode(settings.buffering_mode);
                     osd_state.needs_redraw = true;
                 }
+                else if (osd_menu_state.selected_item == 3)
+                { // Scaling - cycle INTEGER, FIT, ZOOM and SCALE2X (VGA only), SCALE2X is skipped outside div 4 modes
+                    if (settings.video_out_type == VGA)
+                    {
+                        settings.scaling_mode = (settings.scaling_mode == SCALE_MODE_MAX) ? SCALE_MODE_MIN : settings.scaling_mode + 1;
+
+                        if (settings.scaling_mode == SCALE_2X && video_modes[settings.video_out_mode]->div != 4)
+                            settings.scaling_mode = SCALE_MODE_MIN;
+
+                        if (active_video_output == VGA)
+                        {
+                            stop_video_output();
+                            start_video_output(active_video_output);
+                            // Adjust capture frequency for new system clock
+                            set_capture_frequency(settings.frequency);
+                        }
+
+                        osd_state.needs_redraw = true;
+                    }
+                }
+                else if (osd_menu_state.selected_item == 4)
+                { // Blending - toggle, mixes the last two frames of X3 buffering
+                    if (settings.buffering_mode)
+                    {
+                        settings.blend_mode = !settings.blend_mode;
+
+                        if (active_video_output == settings.video_out_type)
+                        {
+                            stop_video_output();
+                            start_video_output(active_video_output);
+                            set_capture_frequency(settings.frequency);
+                        }
+
+                        osd_state.needs_redraw = true;
+                    }
+                }
+                else if (osd_menu_state.selected_item == 5)
+                { // OSD background - toggle, the output ISR reads the setting on every line
+                    settings.osd_translucent = !settings.osd_translucent;
+                    osd_state.needs_redraw = true;
+                }
             }
             else if (osd_menu.current_menu == MENU_TYPE_CAPTURE)
             {                                // Capture submenu selection
@@ -523,8 +697,8 @@ void osd_menu_update()
                 }
             }
 #endif
-            else if (osd_menu.current_menu == MENU_TYPE_ABOUT)
-            { // About submenu - only BACK button
+            else if (osd_menu.current_menu == MENU_TYPE_ABOUT || osd_menu.current_menu == MENU_TYPE_STATS)
+            { // About and statistics pages - only BACK button
                 if (osd_menu_state.selected_item == 0)
                 { // Back to Main
                     menu_changed = osd_menu_go_back();
@@ -556,6 +730,9 @@ void osd_menu_update()
         }
 #endif
 
+        if (osd_menu.current_menu == MENU_TYPE_STATS)
+            stats_update();
+
         osd_flush_render();
     }
 }
@@ -604,6 +781,7 @@ static void render_main_menu()
 #ifdef MAIN_ITEM_FF_OSD
         "FF OSD CONFIG",
 #endif
+        "STATISTICS",
         "ABOUT",
         "SAVE",
         "EXIT"};
@@ -614,7 +792,7 @@ static void render_main_menu()
         uint8_t fg_color, bg_color;
         menu_item_colors(i == osd_menu_state.selected_item, false, OSD_COLOR_TEXT, &fg_color, &bg_color);
 
-        if (i < MAIN_ITEM_ABOUT)
+        if (i < MAIN_ITEM_STATS)
             osd_text_printf(row, 2, fg_color, bg_color, 0, "%-16s >", items[i]);
         else
             osd_text_print(row, 2, items[i], fg_color, bg_color, 0);
@@ -625,7 +803,7 @@ static void render_output_menu()
 {
     osd_text_print_centered(OSD_SUBTITLE_ROW, "OUTPUT SETTINGS", OSD_COLOR_SELECTED, OSD_COLOR_BACKGROUND, 0);
 
-    for (int i = 0; i < 4; i++)
+    for (int i = 0; i < 7; i++)
     {
         uint8_t row = OSD_MENU_START_ROW + i;
         uint8_t color = OSD_COLOR_TEXT;
@@ -633,18 +811,13 @@ static void render_output_menu()
 
         if (i == 1)
         {
-            if (settings.video_out_type == DVI)
+            if (settings.video_out_type == VGA && settings.scaling_mode != SCALE_INTEGER)
                 color = OSD_COLOR_DIMMED;
-            else if (settings.video_out_type == VGA)
-            {
-#ifndef SCANLINES_ENABLE_LOW_RES
-                uint8_t div = video_modes[settings.video_out_mode]->div;
-
-                if (div != 3 && div != 4)
-                    color = OSD_COLOR_DIMMED;
-#endif
-            }
         }
+        else if (i == 3 && settings.video_out_type == DVI)
+            color = OSD_COLOR_DIMMED;
+        else if (i == 4 && !settings.buffering_mode)
+            color = OSD_COLOR_DIMMED;
 
         menu_item_colors(i == osd_menu_state.selected_item, i == 0 && osd_menu_state.tuning_mode, color, &fg_color, &bg_color);
 
@@ -653,7 +826,8 @@ static void render_output_menu()
             const char *mode_names_dvi[] = {"640X480@60", "720X576@50"};
             const char *mode_names_vga[] = {"640X480@60", "800X600@60",
                                             "1024X768@60 DIV3", "1024X768@60 DIV4",
-                                            "1280X1024@60 DIV3", "1280X1024@60 DIV4"};
+                                            "1280X1024@60 DIV3", "1280X1024@60 DIV4",
+                                            "800X600@50", "1024X768@50", "1280X1024@50 DIV3"};
             const char *current_mode_name = "UNKNOWN";
             if (settings.video_out_type == DVI)
             {
@@ -676,14 +850,31 @@ static void render_output_menu()
                     current_mode_name = mode_names_vga[4];
                 else if (settings.video_out_mode == MODE_1280x1024_60Hz_d4)
                     current_mode_name = mode_names_vga[5];
+                else if (settings.video_out_mode == MODE_800x600_50Hz)
+                    current_mode_name = mode_names_vga[6];
+                else if (settings.video_out_mode == MODE_1024x768_50Hz)
+                    current_mode_name = mode_names_vga[7];
+                else if (settings.video_out_mode == MODE_1280x1024_50Hz_d3)
+                    current_mode_name = mode_names_vga[8];
             }
             osd_text_printf(row, 2, fg_color, bg_color, 0, "%-9s %s", "MODE", current_mode_name);
         }
         else if (i == 1)
-            osd_text_printf(row, 2, fg_color, bg_color, 0, "%-9s %s", "SCANLINES", settings.scanlines_mode ? "ON" : "OFF");
+            osd_text_printf(row, 2, fg_color, bg_color, 0, "%-9s %s", "SCANLINES", settings.scanlines_mode ? (settings.scanlines_dim ? "DIM" : "ON") : "OFF");
         else if (i == 2)
             osd_text_printf(row, 2, fg_color, bg_color, 0, "%-9s %s", "BUFFERING", settings.buffering_mode ? "X3" : "X1");
         else if (i == 3)
+        {
+            const char *scaling_names[] = {"INTEGER", "FIT", "ZOOM", "SCALE2X"};
+            // a mode switch can leave SCALE2X set in a mode where it falls back to integer scaling
+            bool inactive = settings.scaling_mode == SCALE_2X && video_modes[settings.video_out_mode]->div != 4;
+            osd_text_printf(row, 2, fg_color, bg_color, 0, "%-9s %s%s", "SCALING", scaling_names[settings.scaling_mode], inactive ? " N/A" : "");
+        }
+        else if (i == 4)
+            osd_text_printf(row, 2, fg_color, bg_color, 0, "%-9s %s", "BLENDING", settings.blend_mode ? "ON" : "OFF");
+        else if (i == 5)
+            osd_text_printf(row, 2, fg_color, bg_color, 0, "%-9s %s", "OSD BG", settings.osd_translucent ? "TRANSLUCENT" : "SOLID");
+        else if (i == 6)
             osd_text_print(row, 2, "< BACK TO MAIN", fg_color, bg_color, 0);
 
         if (i == 0 && i == osd_menu_state.selected_item && osd_menu_state.tuning_mode)
@@ -849,6 +1040,19 @@ static void render_about_menu()
     osd_text_print(OSD_MENU_START_ROW + 7, 2, "< BACK TO MAIN", fg_color, bg_color, 0);
 }
 
+static void render_stats_menu()
+{
+    osd_text_print_centered(OSD_SUBTITLE_ROW, "STATISTICS", OSD_COLOR_SELECTED, OSD_COLOR_BACKGROUND, 0);
+
+    for (int i = 0; i < STATS_ROW_COUNT; i++)
+        osd_text_printf(OSD_MENU_START_ROW + i, 2, OSD_COLOR_TEXT, OSD_COLOR_BACKGROUND, 0, "%-9s %s", stats_labels[i], stats_text[i]);
+
+    uint8_t fg_color, bg_color;
+    menu_item_colors(osd_menu_state.selected_item == 0, false, OSD_COLOR_TEXT, &fg_color, &bg_color);
+
+    osd_text_print(OSD_MENU_START_ROW + STATS_ROW_COUNT + 1, 2, "< BACK TO MAIN", fg_color, bg_color, 0);
+}
+
 void osd_update_text_buffer()
 { // Clear text buffer
     osd_clear_text_buffer();
@@ -885,6 +1089,10 @@ void osd_update_text_buffer()
         render_about_menu();
         break;
 
+    case MENU_TYPE_STATS:
+        render_stats_menu();
+        break;
+
 #ifdef MAIN_ITEM_FF_OSD
     case MENU_TYPE_FF_OSD:
         render_ff_osd_menu();
@@ -1032,7 +1240,8 @@ void osd_adjust_video_mode(int8_t direction)
     video_out_mode_t modes_dvi[] = {MODE_640x480_60Hz, MODE_720x576_50Hz};
     video_out_mode_t modes_vga[] = {MODE_640x480_60Hz, MODE_800x600_60Hz,
                                     MODE_1024x768_60Hz_d3, MODE_1024x768_60Hz_d4,
-                                    MODE_1280x1024_60Hz_d3, MODE_1280x1024_60Hz_d4};
+                                    MODE_1280x1024_60Hz_d3, MODE_1280x1024_60Hz_d4,
+                                    MODE_800x600_50Hz, MODE_1024x768_50Hz, MODE_1280x1024_50Hz_d3};
 
     video_out_mode_t *modes;
     uint8_t mode_count;
@@ -1045,7 +1254,7 @@ void osd_adjust_video_mode(int8_t direction)
     else
     {
         modes = modes_vga;
-        mode_count = 6;
+        mode_count = 9;
     }
 
     // Find current mode index
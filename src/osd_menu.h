@@ -15,6 +15,7 @@
 #define MENU_TYPE_MASK 4
 #define MENU_TYPE_ABOUT 5
 #define MENU_TYPE_FF_OSD 6
+#define MENU_TYPE_STATS 7
 
 // Menu-specific OSD state extension
 typedef struct
@@ -3,6 +3,7 @@
 #include "hardware/irq.h"
 #include "hardware/structs/pll.h"
 #include "hardware/structs/systick.h"
+#include "hardware/timer.h"
 
 #include "g_config.h"
 #include "rgb_capture.h"
@@ -26,6 +27,19 @@ static uint16_t v_sync_pulse;
 static volatile uint8_t capture_sync_mask = (uint8_t)(1u << HS_PIN);
 
 volatile uint32_t frame_count = 0;
+volatile bool no_signal = false;
+// statistics: SysTick cycles spent in the capture ISR (core 1), sampled bytes
+volatile uint32_t cap_isr_cycles = 0;
+volatile uint32_t cap_samples = 0;
+// measured sync timing of the last frame: lines between VSYNCs and the VSYNC period
+volatile uint16_t cap_frame_lines = 0;
+volatile uint32_t cap_frame_us = 0;
+static uint32_t cap_vsync_time_s;
+
+// sync watchdog: hardware alarm re-armed at every VSYNC once the source is locked
+static int sync_alarm = -1;
+
+static volatile bool capture_running = false;
 
 // Ring buffer: 16 line buffers
 static uint8_t cap_dma_buf[CAP_DMA_BUF_COUNT][CAP_LINE_LENGTH];
@@ -38,6 +52,10 @@ static uint cap_CS_idx_s;
 static uint8_t cap_pix8_s;
 static uint8_t *cap_buf8_s;
 static uint8_t *cap_buf;
+// lock onto the source: line count of the last frame and the number of equal frames in a row
+static int cap_frame_lines_s;
+static uint8_t cap_stable_frames_s;
+static bool cap_locked_s;
 static uint32_t cap_active_buf_idx;
 
 void set_capture_frequency(uint32_t frequency)
@@ -143,6 +161,8 @@ void set_video_sync_mode(bool video_sync_mode)
 
 void __attribute__((hot)) __not_in_flash_func(dma_handler_capture())
 {
+  uint32_t start = systick_hw->cvr;
+
   int x = cap_x_s;
   int y = cap_y_s;
   uint CS_idx = cap_CS_idx_s;
@@ -212,11 +232,38 @@ void __attribute__((hot)) __not_in_flash_func(dma_handler_capture())
 
     if (y >= 0)
     {
-      // Start capture of a new frame (with startup noise immunity).
-      if (frame_count > 10)
+      uint32_t now = timer_hw->timerawl;
+
+      cap_frame_lines = y + shY + 1;
+      cap_frame_us = now - cap_vsync_time_s;
+      cap_vsync_time_s = now;
+
+      // Start capture of a new frame once the source is stable (startup noise immunity).
+      if (cap_locked_s)
+      { // after a signal loss NO SIGNAL stays until a whole frame has been captured into a buffer
+        if (cap_buf != NULL)
+          no_signal = false;
+
         cap_buf = get_v_buf_in();
-      else if (frame_count == 5)
-        clear_video_buffers();
+        timer_hw->alarm[sync_alarm] = now + NO_SIGNAL_TIMEOUT_US;
+      }
+      else
+      {
+        int lines = y - cap_frame_lines_s;
+
+        cap_stable_frames_s = (lines >= -1 && lines <= 1) ? cap_stable_frames_s + 1 : 0;
+        cap_frame_lines_s = y;
+
+        // an unstable source is still captured after 10 frames
+        if (cap_stable_frames_s >= CAP_LOCK_FRAMES || frame_count >= 10)
+        { // the welcome screen is cleared, capture begins with the next frame
+          clear_video_buffers();
+          cap_locked_s = true;
+
+          if (boot_time[BOOT_LOCK] == 0)
+            boot_time[BOOT_LOCK] = time_us_32();
+        }
+      }
 
       frame_count++;
     }
@@ -229,19 +276,50 @@ void __attribute__((hot)) __not_in_flash_func(dma_handler_capture())
   cap_pix8_s = pix8;
   cap_buf8_s = cap_buf8;
   cap_CS_idx_s = CS_idx;
+
+  cap_samples += CAP_LINE_LENGTH;
+  cap_isr_cycles += (start - systick_hw->cvr) & 0x00ffffff;
+}
+
+// no VSYNC in time: stop writing, the output shows NO SIGNAL until the first valid frame is captured
+// only flags here, this IRQ runs on the capture core next to the capture DMA ISR
+static void __not_in_flash_func(sync_watchdog_handler)()
+{
+  timer_hw->intr = 1u << sync_alarm;
+
+  no_signal = true;
+  cap_buf = NULL;
+}
+
+// true while the DMA chain runs, and while capture is stopped (nothing to check)
+bool __not_in_flash_func(capture_dma_busy)()
+{
+  if (!capture_running)
+    return true;
+
+  return dma_channel_is_busy(dma_ch0) || dma_channel_is_busy(dma_ch1);
 }
 
 void start_capture()
 {
-  // Reset capture handler state (video buffers cleared later at frame_count == 5)
+  // Reset capture handler state (video buffers cleared later when the source is stable)
   cap_x_s = 0;
   cap_y_s = 0;
   cap_CS_idx_s = 0;
   cap_pix8_s = 0;
   cap_buf8_s = g_v_buf;
   cap_buf = NULL;
+  cap_frame_lines_s = 0;
+  cap_stable_frames_s = 0;
+  cap_locked_s = false;
   cap_active_buf_idx = 0;
   frame_count = 0;
+  no_signal = false;
+
+  // SysTick of core 1 on the system clock for the ISR load
+  systick_hw->rvr = 0x00ffffff;
+  systick_hw->cvr = 0;
+  systick_hw->csr = 0x5;
 
   uint8_t pin_inversion_mask = settings.pin_inversion_mask;
 
@@ -353,17 +431,38 @@ void start_capture()
   irq_set_exclusive_handler(DMA_IRQ_1, dma_handler_capture);
   irq_set_enabled(DMA_IRQ_1, true);
 
+  // sync watchdog on this core, armed by the first VSYNC after the source is locked
+  if (sync_alarm < 0)
+    sync_alarm = hardware_alarm_claim_unused(true);
+
+  hw_set_bits(&timer_hw->inte, 1u << sync_alarm);
+  irq_set_exclusive_handler(TIMER_IRQ_0 + sync_alarm, sync_watchdog_handler);
+  irq_set_enabled(TIMER_IRQ_0 + sync_alarm, true);
+
+  // the state machine may have stalled before the DMA started, that is not an overflow
+  PIO_CAP->fdebug = 1u << (PIO_FDEBUG_RXSTALL_LSB + SM_CAP);
+  capture_running = true;
+
   dma_start_channel_mask((1u << dma_ch0));
 }
 
 void stop_capture()
 {
+  capture_running = false;
+
   // disable IRQ first to prevent handlers from running during cleanup
   irq_set_enabled(DMA_IRQ_1, false);
 
   // clear the IRQ handler to prevent conflicts with restarting capture
   irq_remove_handler(DMA_IRQ_1, dma_handler_capture);
 
+  // disarm the sync watchdog
+  irq_set_enabled(TIMER_IRQ_0 + sync_alarm, false);
+  irq_remove_handler(TIMER_IRQ_0 + sync_alarm, sync_watchdog_handler);
+  hw_clear_bits(&timer_hw->inte, 1u << sync_alarm);
+  timer_hw->armed = 1u << sync_alarm;
+  timer_hw->intr = 1u << sync_alarm;
+
   // stop PIO
   pio_sm_set_enabled(PIO_CAP, SM_CAP, false);
   pio_sm_init(PIO_CAP, SM_CAP, offset, NULL);
@@ -1,6 +1,11 @@
 #pragma once
 
 extern volatile uint32_t frame_count;
+extern volatile bool no_signal;
+extern volatile uint32_t cap_isr_cycles;
+extern volatile uint32_t cap_samples;
+extern volatile uint16_t cap_frame_lines;
+extern volatile uint32_t cap_frame_us;
 
 void set_capture_frequency(uint32_t);
 int8_t set_ext_clk_divider(int8_t);
@@ -9,5 +14,6 @@ int16_t set_capture_shY(int16_t);
 int8_t set_capture_delay(int8_t);
 void set_pin_inversion_mask(uint8_t);
 void set_video_sync_mode(bool);
+bool capture_dma_busy();
 void start_capture();
 void stop_capture();
\ No newline at end of file
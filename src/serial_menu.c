@@ -5,9 +5,13 @@
 
 #include "g_config.h"
 #include "serial_menu.h"
+#include "frame_grab.h"
+#include "health.h"
 #include "rgb_capture.h"
 #include "settings.h"
+#include "telemetry.h"
 #include "v_buf.h"
+#include "vga.h"
 #include "video_output.h"
 
 #ifdef OSD_FF_ENABLE
@@ -62,8 +66,10 @@ void print_main_menu()
     printf("  o   set video output type (DVI/VGA)\n");
     printf("  v   set video resolution\n");
 
+    printf("  s   set scanlines mode\n");
+
     if (settings.video_out_type == VGA)
-        printf("  s   set scanlines mode\n");
+        printf("  x   set scaling mode\n");
 
     printf("  b   set buffering mode\n");
     printf("  c   set capture synchronization source\n");
@@ -101,6 +107,9 @@ void print_video_out_menu()
         printf("  4   1024x768 @60Hz (div 4)\n");
         printf("  5  1280x1024 @60Hz (div 3)\n");
         printf("  6  1280x1024 @60Hz (div 4)\n");
+        printf("  7    800x600 @50Hz (div 2)\n");
+        printf("  8   1024x768 @50Hz (div 2)\n");
+        printf("  9  1280x1024 @50Hz (div 3)\n");
         break;
 
     default:
@@ -128,7 +137,22 @@ void print_scanlines_mode_menu()
 {
     printf("\n      * Scanlines mode *\n\n");
 
-    printf("  s   change scanlines mode\n\n");
+    printf("  s   change scanlines mode\n");
+    printf("  d   change scanlines intensity (black/dimmed)\n\n");
+
+    printf("  p   show configuration\n");
+    printf("  h   show help (this menu)\n");
+    printf("  q   exit to main menu\n\n");
+}
+
+void print_scaling_mode_menu()
+{
+    printf("\n      * Scaling mode *\n\n");
+
+    printf("  1   integer (pixel divider of the video mode)\n");
+    printf("  2   fit (aspect-correct fractional scaling)\n");
+    printf("  3   zoom (crop the border, scale the picture)\n");
+    printf("  4   scale2x (pixel-art smoothing, div 4 modes)\n\n");
 
     printf("  p   show configuration\n");
     printf("  h   show help (this menu)\n");
@@ -139,7 +163,8 @@ void print_buffering_mode_menu()
 {
     printf("\n      * Buffering mode *\n\n");
 
-    printf("  b   change buffering mode\n\n");
+    printf("  b   change buffering mode\n");
+    printf("  e   change frame blending (x3 only)\n\n");
 
     printf("  p   show configuration\n");
     printf("  h   show help (this menu)\n");
@@ -230,6 +255,15 @@ void print_test_menu()
     printf("  2   draw welcome image (horizontal stripes)\n");
     printf("  3   draw \"NO SIGNAL\" screen\n");
     printf("  i   show captured frame count\n");
+    printf("  c   show VGA line render time\n");
+    printf("  a   measure VGA line render time in every mode (switches the output)\n");
+    printf("  w   show blank time of the last output switch\n");
+    printf("  t   show boot timing\n");
+    printf("  m   show health monitor counters\n");
+    printf("  r   reset health monitor counters\n");
+    printf("  l   stream binary telemetry (leaves the menu, any key stops it)\n");
+    printf("  f   grab the captured frame (leaves the menu, tools/frame_grab.py)\n");
+    printf("  v   stream video (leaves the menu, tools/stream_viewer.py, any key stops it)\n");
 #ifdef OSD_FF_ENABLE
     printf("  g   show FlashFloppy OSD display data\n");
 #endif
@@ -292,6 +326,18 @@ void print_video_out_mode()
         printf("1280x1024 @60Hz (div 4)\n");
         break;
 
+    case MODE_800x600_50Hz:
+        printf("800x600 @50Hz\n");
+        break;
+
+    case MODE_1024x768_50Hz:
+        printf("1024x768 @50Hz\n");
+        break;
+
+    case MODE_1280x1024_50Hz_d3:
+        printf("1280x1024 @50Hz (div 3)\n");
+        break;
+
     default:
         break;
     }
@@ -301,12 +347,162 @@ void print_scanlines_mode()
 {
     printf("  Scanlines ................... ");
 
-    if (settings.scanlines_mode)
-        printf("enabled\n");
+    // DVI only has dimmed scanlines, black scanlines are VGA only
+    if (settings.scanlines_mode && settings.scanlines_dim)
+        printf("enabled (dimmed)\n");
+    else if (settings.scanlines_mode)
+        printf(settings.video_out_type == VGA ? "enabled\n" : "enabled (VGA only)\n");
     else
         printf("disabled\n");
 }
 
+void print_switch_time()
+{
+    // the first frame of the new output starts within a frame time after the switch
+    for (int i = 0; i < 100 && get_video_output_switch_time() == 0; i++)
+        sleep_ms(1);
+
+    printf("  Output switch blank time .... ");
+    printf("%lu us\n", get_video_output_switch_time());
+}
+
+void print_render_time()
+{
+    get_vga_render_cycles();
+    get_vga_osd_render_cycles();
+    sleep_ms(100);
+
+    uint32_t cycles = get_vga_render_cycles();
+    uint32_t osd_cycles = get_vga_osd_render_cycles();
+
+    printf("  Line render time ............ ");
+    printf("%lu cycles (max), budget %lu cycles\n", cycles, get_vga_render_budget(video_modes[settings.video_out_mode], settings.scaling_mode));
+
+    // lines with OSD are only measured while the OSD is on screen
+    if (osd_cycles)
+    {
+        printf("  OSD line render time ........ ");
+        printf("%lu cycles (max)\n", osd_cycles);
+    }
+}
+
+static void restart_video_output()
+{
+    stop_video_output();
+    start_video_output(active_video_output);
+    // capture PIO clock divider needs to be adjusted for new system clock frequency set in start_video_output()
+    set_capture_frequency(settings.frequency);
+}
+
+// every VGA mode with the current scaling, the configured mode is restored afterwards
+void print_render_time_all_modes()
+{
+    uint8_t video_out_mode = settings.video_out_mode;
+
+    for (int mode = VIDEO_MODE_MIN; mode <= VIDEO_MODE_MAX; mode++)
+    {
+        if (mode == MODE_720x576_50Hz) // DVI only
+            continue;
+
+        settings.video_out_mode = mode;
+        restart_video_output();
+        // the monitor and the capture settle within a few frames
+        sleep_ms(300);
+
+        printf("\n");
+        print_video_out_mode();
+
+        printf("  System clock frequency ...... ");
+        printf("%lu kHz\n", get_vga_sys_freq(video_modes[mode], settings.scaling_mode));
+
+        print_render_time();
+    }
+
+    settings.video_out_mode = video_out_mode;
+    restart_video_output();
+    printf("\n");
+}
+
+void print_boot_time()
+{
+    const char *names[BOOT_PHASE_COUNT] = {
+        "Voltage regulator ........... ",
+        "Serial port ................. ",
+        "Settings .................... ",
+        "Video output ................ ",
+        "Welcome screen .............. ",
+        "Capture ..................... ",
+        "Source lock ................. ",
+    };
+
+    printf("\n      * Boot timing (since reset) *\n\n");
+
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++)
+    {
+        printf("  %s", names[i]);
+
+        if (boot_time[i] != 0)
+            printf("%lu us\n", boot_time[i]);
+        else
+            printf("pending\n");
+    }
+
+    printf("\n");
+}
+
+void print_health()
+{
+    const char *names[HEALTH_EVENT_COUNT] = {
+        "Capture FIFO overflows ...... ",
+        "Capture DMA stops ........... ",
+        "Output FIFO underruns ....... ",
+        "Output FIFO overruns ........ ",
+        "Output DMA stops ............ ",
+    };
+
+    printf("\n      * Health monitor *\n\n");
+
+    for (int i = 0; i < HEALTH_EVENT_COUNT; i++)
+    {
+        printf("  %s%lu", names[i], health_events[i].count);
+
+        if (health_events[i].count != 0)
+            printf(" (last at %lu ms)", health_events[i].last_time / 1000);
+
+        printf("\n");
+    }
+
+    printf("\n");
+}
+
+void print_scaling_mode()
+{
+    printf("  Scaling mode ................ ");
+
+    switch (settings.scaling_mode)
+    {
+    case SCALE_INTEGER:
+        printf("integer\n");
+        break;
+
+    case SCALE_FIT:
+        printf("fit\n");
+        break;
+
+    case SCALE_ZOOM:
+        printf("zoom\n");
+        break;
+
+    case SCALE_2X:
+        // outside div 4 modes the output falls back to integer scaling
+        printf(video_modes[settings.video_out_mode]->div == 4 ? "scale2x\n" : "scale2x (inactive, div 4 modes only)\n");
+        break;
+
+    default:
+        break;
+    }
+}
+
 void print_buffering_mode()
 {
     printf("  Buffering mode .............. ");
@@ -317,6 +513,16 @@ void print_buffering_mode()
         printf("x1\n");
 }
 
+void print_blend_mode()
+{
+    printf("  Frame blending .............. ");
+
+    if (settings.blend_mode)
+        printf("on\n");
+    else
+        printf("off\n");
+}
+
 void print_cap_sync_mode()
 {
     printf("  Capture sync source ......... ");
@@ -398,7 +604,9 @@ void print_dividers()
     {
         printf("  Video output clock divider .. ");
 
-        pio_calculate_clkdiv_from_float(((float)clock_get_hz(clk_sys) * video_mode.div) / video_mode.pixel_freq, &div_int, &div_frac);
+        uint8_t unit = get_vga_unit(&video_mode, settings.scaling_mode);
+
+        pio_calculate_clkdiv_from_float(((float)clock_get_hz(clk_sys) * unit) / video_mode.pixel_freq, &div_int, &div_frac);
 
         printf("%.8f", (div_int + (float)div_frac / 256));
 
@@ -516,11 +724,13 @@ void print_settings()
     printf("\n");
     print_video_out_type();
     print_video_out_mode();
+    print_scanlines_mode();
 
     if (settings.video_out_type == VGA)
-        print_scanlines_mode();
+        print_scaling_mode();
 
     print_buffering_mode();
+    print_blend_mode();
     print_cap_sync_mode();
     print_capture_frequency();
     print_ext_clk_divider();
@@ -535,11 +745,26 @@ void print_settings()
 
 void handle_serial_menu()
 {
-    char inchar = get_menu_input(100);
+    // no input wait while a binary stream is sent from the main loop
+    bool streaming = telemetry_active() || frame_grab_active();
+    char inchar = get_menu_input(streaming ? 0 : 100);
 
     if (inchar == 0)
         return;
 
+    // any key ends the binary stream, the menu text follows
+    if (telemetry_active())
+    {
+        telemetry_stop();
+        printf("\n Telemetry stopped\n");
+    }
+
+    if (frame_grab_active())
+    {
+        frame_grab_stop();
+        printf("\n Frame grab or video stream stopped\n");
+    }
+
     inchar = 'h';
 
     printf(" Entering the configuration mode\n\n");
@@ -684,6 +909,33 @@ void handle_serial_menu()
 
                     break;
 
+                case '7':
+                    if (settings.video_out_type == VGA)
+                    {
+                        settings.video_out_mode = MODE_800x600_50Hz;
+                        print_video_out_mode();
+                    }
+
+                    break;
+
+                case '8':
+                    if (settings.video_out_type == VGA)
+                    {
+                        settings.video_out_mode = MODE_1024x768_50Hz;
+                        print_video_out_mode();
+                    }
+
+                    break;
+
+                case '9':
+                    if (settings.video_out_type == VGA)
+                    {
+                        settings.video_out_mode = MODE_1280x1024_50Hz_d3;
+                        print_video_out_mode();
+                    }
+
+                    break;
+
                 default:
                     break;
                 }
@@ -694,6 +946,7 @@ void handle_serial_menu()
                     start_video_output(active_video_output);
                     // capture PIO clock divider needs to be adjusted for new system clock frequency set in start_video_output()
                     set_capture_frequency(settings.frequency);
+                    print_switch_time();
                 }
 
                 if (inchar == 'q')
@@ -709,6 +962,61 @@ void handle_serial_menu()
         }
 
         case 's':
+        {
+            inchar = 'h';
+
+            while (1)
+            {
+                if (inchar != 'h')
+                    inchar = get_menu_input(10);
+
+                switch (inchar)
+                {
+                case 'p':
+                    print_scanlines_mode();
+                    break;
+
+                case 'h':
+                    print_scanlines_mode_menu();
+                    break;
+
+                case 's':
+                case 'd':
+                    if (inchar == 's')
+                        settings.scanlines_mode = !settings.scanlines_mode;
+                    else
+                        settings.scanlines_dim = !settings.scanlines_dim;
+
+                    print_scanlines_mode();
+                    set_scanlines_mode();
+
+                    // DVI allocates the dimmed scanline buffer at start, black scanlines are VGA only
+                    if (active_video_output == DVI && settings.video_out_type == DVI)
+                    {
+                        stop_video_output();
+                        start_video_output(DVI);
+                        set_capture_frequency(settings.frequency);
+                    }
+
+                    break;
+
+                default:
+                    break;
+                }
+
+                if (inchar == 'q')
+                {
+                    inchar = 'h';
+                    break;
+                }
+
+                inchar = 0;
+            }
+
+            break;
+        }
+
+        case 'x':
         {
             if (settings.video_out_type != VGA)
             {
@@ -723,26 +1031,50 @@ void handle_serial_menu()
                 if (inchar != 'h')
                     inchar = get_menu_input(10);
 
+                uint8_t scaling_mode = settings.scaling_mode;
+
                 switch (inchar)
                 {
                 case 'p':
-                    print_scanlines_mode();
+                    print_scaling_mode();
                     break;
 
                 case 'h':
-                    print_scanlines_mode_menu();
+                    print_scaling_mode_menu();
                     break;
 
-                case 's':
-                    settings.scanlines_mode = !settings.scanlines_mode;
-                    print_scanlines_mode();
-                    set_scanlines_mode();
+                case '1':
+                    settings.scaling_mode = SCALE_INTEGER;
+                    print_scaling_mode();
+                    break;
+
+                case '2':
+                    settings.scaling_mode = SCALE_FIT;
+                    print_scaling_mode();
+                    break;
+
+                case '3':
+                    settings.scaling_mode = SCALE_ZOOM;
+                    print_scaling_mode();
+                    break;
+
+                case '4':
+                    settings.scaling_mode = SCALE_2X;
+                    print_scaling_mode();
                     break;
 
                 default:
                     break;
                 }
 
+                if (scaling_mode != settings.scaling_mode && active_video_output == VGA)
+                {
+                    stop_video_output();
+                    start_video_output(active_video_output);
+                    // capture PIO clock divider needs to be adjusted for new system clock frequency set in start_video_output()
+                    set_capture_frequency(settings.frequency);
+                }
+
                 if (inchar == 'q')
                 {
                     inchar = 'h';
@@ -768,6 +1100,7 @@ void handle_serial_menu()
                 {
                 case 'p':
                     print_buffering_mode();
+                    print_blend_mode();
                     break;
 
                 case 'h':
@@ -780,6 +1113,22 @@ void handle_serial_menu()
                     set_buffering_mode(settings.buffering_mode);
                     break;
 
+                case 'e':
+                    if (!settings.buffering_mode)
+                        break;
+
+                    settings.blend_mode = !settings.blend_mode;
+                    print_blend_mode();
+
+                    if (active_video_output == settings.video_out_type)
+                    {
+                        stop_video_output();
+                        start_video_output(active_video_output);
+                        set_capture_frequency(settings.frequency);
+                    }
+
+                    break;
+
                 default:
                     break;
                 }
@@ -1373,7 +1722,7 @@ void handle_serial_menu()
                         else if (inchar == '2')
                             draw_welcome_screen_h(*(video_modes[settings.video_out_mode]));
                         else
-                            draw_no_signal(*(video_modes[settings.video_out_mode]));
+                            draw_no_signal();
                     }
 
                     break;
@@ -1384,6 +1733,88 @@ void handle_serial_menu()
                     printf("%d\n", frame_count);
                     break;
 
+                case 'c':
+                    if (active_video_output == VGA)
+                        print_render_time();
+
+                    break;
+
+                case 'a':
+                    if (active_video_output == VGA)
+                        print_render_time_all_modes();
+
+                    break;
+
+                case 'w':
+                    print_switch_time();
+                    break;
+
+                case 't':
+                    print_boot_time();
+                    break;
+
+                case 'm':
+                    print_health();
+                    break;
+
+                case 'r':
+                    health_reset();
+                    print_health();
+                    break;
+
+                case 'l':
+                {
+                    char rate_str[4] = "";
+                    int str_len = 0;
+
+                    printf("  Enter telemetry rate (%d - %d Hz): ", TELEMETRY_RATE_MIN, TELEMETRY_RATE_MAX);
+
+                    while (1)
+                    {
+                        inchar = get_menu_input(10);
+
+                        if (inchar >= '0' && inchar <= '9' && str_len < 3)
+                        {
+                            printf("%c", inchar);
+                            rate_str[str_len++] = inchar;
+                            rate_str[str_len] = '\0';
+                        }
+                        else if (inchar == 8 || inchar == 127) // Backspace
+                        {
+                            if (str_len > 0)
+                            {
+                                str_len--;
+                                rate_str[str_len] = '\0';
+                                printf("\b \b");
+                            }
+                        }
+                        else if (inchar == '\r' || inchar == '\n')
+                            break;
+                    }
+
+                    uint32_t rate = str_len > 0 ? string_to_int(rate_str) : TELEMETRY_RATE_DEF;
+
+                    if (rate > TELEMETRY_RATE_MAX)
+                        rate = TELEMETRY_RATE_MAX;
+
+                    printf("\n Leaving the configuration mode, streaming telemetry\n\n");
+                    stdio_flush();
+                    telemetry_start(rate);
+                    return;
+                }
+
+                case 'f':
+                    printf(" Leaving the configuration mode, sending the frame\n\n");
+                    stdio_flush();
+                    frame_grab_start();
+                    return;
+
+                case 'v':
+                    printf(" Leaving the configuration mode, streaming video\n\n");
+                    stdio_flush();
+                    frame_stream_start();
+                    return;
+
 #ifdef OSD_FF_ENABLE
                 case 'g':
                 {
@@ -1414,6 +1845,16 @@ void handle_serial_menu()
                         printf("\"\n");
                     }
 
+                    printf("\n      I2C\n\n");
+                    printf("  Bytes ....................... ");
+                    printf("%lu\n", ff_osd_i2c_bytes);
+                    printf("  Transactions ................ ");
+                    printf("%lu\n", ff_osd_i2c_transactions);
+                    printf("  Dropped (ring full) ......... ");
+                    printf("%lu\n", ff_osd_i2c_overflows);
+                    printf("  Phantom transactions ........ ");
+                    printf("%lu\n", ff_osd_i2c_phantoms);
+
                     printf("\n");
                     break;
                 }
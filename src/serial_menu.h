@@ -7,6 +7,7 @@ void print_main_menu();
 void print_video_out_menu();
 void print_video_out_type_menu();
 void print_scanlines_mode_menu();
+void print_scaling_mode_menu();
 void print_buffering_mode_menu();
 void print_cap_sync_mode_menu();
 void print_capture_frequency_menu();
@@ -20,7 +21,14 @@ void print_test_menu();
 void print_video_out_type();
 void print_video_out_mode();
 void print_scanlines_mode();
+void print_switch_time();
+void print_render_time();
+void print_render_time_all_modes();
+void print_boot_time();
+void print_health();
+void print_scaling_mode();
 void print_buffering_mode();
+void print_blend_mode();
 void print_cap_sync_mode();
 void print_capture_frequency();
 void print_ext_clk_divider();
@@ -23,6 +23,10 @@ void check_settings(settings_t *settings)
       settings->video_out_mode < VIDEO_OUT_MODE_MIN)
     settings->video_out_mode = VIDEO_OUT_MODE_DEF;
 
+  if (settings->scaling_mode > SCALING_MODE_MAX ||
+      settings->scaling_mode < SCALING_MODE_MIN)
+    settings->scaling_mode = SCALING_MODE_DEF;
+
   if (settings->cap_sync_mode > CAP_SYNC_MODE_MAX ||
       settings->cap_sync_mode < CAP_SYNC_MODE_MIN)
     settings->cap_sync_mode = CAP_SYNC_MODE_DEF;
@@ -51,6 +55,7 @@ void check_settings(settings_t *settings)
   {
     settings->pin_inversion_mask = PIN_INVERSION_MASK_DEF;
     settings->scanlines_mode = false;
+    settings->scanlines_dim = false;
     settings->buffering_mode = false;
     settings->video_sync_mode = false;
   }
@@ -90,7 +95,11 @@ void reset_settings_to_defaults(settings_t *settings)
   settings->shY = shY_DEF;
   settings->pin_inversion_mask = PIN_INVERSION_MASK_DEF;
   settings->scanlines_mode = false;
+  settings->scanlines_dim = false;
   settings->buffering_mode = false;
+  settings->scaling_mode = SCALING_MODE_DEF;
+  settings->blend_mode = false;
+  settings->osd_translucent = false;
   settings->video_sync_mode = false;
 #ifdef OSD_FF_ENABLE
   settings->ff_osd_config = (ff_osd_config_t){
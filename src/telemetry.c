@@ -0,0 +1,123 @@
+#include "pico/stdio_usb.h"
+#include "hardware/clocks.h"
+#include "hardware/timer.h"
+#include "tusb.h"
+
+#include "g_config.h"
+#include "telemetry.h"
+#include "health.h"
+#include "rgb_capture.h"
+#include "v_buf.h"
+#include "video_output.h"
+
+// the layout of FORMAT in tools/telemetry_decoder.py, a new field also needs a new TELEMETRY_VERSION
+static_assert(sizeof(telemetry_packet_t) == 80, "");
+static_assert(offsetof(telemetry_packet_t, crc) == 76, "");
+static_assert(HEALTH_EVENT_COUNT == 5, "");
+
+extern video_out_type_t active_video_output;
+
+static uint32_t period_us = 0; // 0: stopped
+static uint32_t last_send = 0;
+static uint32_t seq = 0;
+static uint16_t skipped = 0;
+
+// CRC-32 (IEEE, same as zlib.crc32), a nibble at a time; start with crc = 0 and chain the results
+uint32_t crc32_update(uint32_t crc, const void *data, uint32_t len)
+{
+  static const uint32_t table[16] = {
+      0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+      0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c};
+  const uint8_t *p = data;
+
+  crc = ~crc;
+
+  while (len--)
+  {
+    crc ^= *p++;
+    crc = (crc >> 4) ^ table[crc & 0x0f];
+    crc = (crc >> 4) ^ table[crc & 0x0f];
+  }
+
+  return ~crc;
+}
+
+void telemetry_start(uint8_t rate)
+{
+  if (rate < TELEMETRY_RATE_MIN)
+    rate = TELEMETRY_RATE_MIN;
+  else if (rate > TELEMETRY_RATE_MAX)
+    rate = TELEMETRY_RATE_MAX;
+
+  period_us = 1000000 / rate;
+  last_send = time_us_32() - period_us;
+  seq = 0;
+  skipped = 0;
+}
+
+void telemetry_stop()
+{
+  period_us = 0;
+}
+
+bool telemetry_active()
+{
+  return period_us != 0;
+}
+
+// called from the main loop: one packet per period, dropped (and counted) instead of waiting for the host
+void telemetry_update()
+{
+  if (period_us == 0)
+    return;
+
+  uint32_t now = time_us_32();
+
+  if (now - last_send < period_us)
+    return;
+
+  last_send = now;
+
+  if (!stdio_usb_connected() || tud_cdc_write_available() < sizeof(telemetry_packet_t))
+  {
+    skipped++;
+    return;
+  }
+
+  telemetry_packet_t p;
+
+  p.magic = TELEMETRY_MAGIC;
+  p.version = TELEMETRY_VERSION;
+  p.size = sizeof(p);
+  p.seq = seq++;
+  p.time_us = now;
+
+  p.in_frames = frame_count;
+  p.out_frames = out_frame_count;
+  p.frames_dropped = frames_dropped;
+  p.frames_repeated = frames_repeated;
+
+  p.cap_samples = cap_samples;
+  p.frame_lines = cap_frame_lines;
+  p.skipped = skipped;
+  p.frame_us = cap_frame_us;
+
+  p.cap_isr_cycles = cap_isr_cycles;
+  p.out_isr_cycles = out_isr_cycles;
+  p.sys_clk_khz = clock_get_hz(clk_sys) / 1000;
+
+  for (int i = 0; i < HEALTH_EVENT_COUNT; i++)
+    p.health[i] = health_events[i].count;
+
+  p.buf_in_idx = v_buf_in_idx;
+  p.buf_out_idx = v_buf_out_idx;
+  p.buf_free = buf_is_free[0] | (buf_is_free[1] << 1) | (buf_is_free[2] << 2);
+  p.flags = (no_signal ? TELEMETRY_FLAG_NO_SIGNAL : 0) |
+            (buffering_mode ? TELEMETRY_FLAG_BUFFERING : 0) |
+            (active_video_output == VGA ? TELEMETRY_FLAG_VGA : 0);
+
+  p.crc = crc32_update(0, &p, offsetof(telemetry_packet_t, crc));
+
+  // raw write without CR/LF translation, the space was checked above so it does not wait
+  stdio_usb.out_chars((const char *)&p, sizeof(p));
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+// binary telemetry over USB CDC, decoded on the host by tools/telemetry_decoder.py
+// all fields little-endian, the layout only changes together with TELEMETRY_VERSION
+#define TELEMETRY_MAGIC 0x545A // "ZT"
+#define TELEMETRY_VERSION 1
+
+#define TELEMETRY_FLAG_NO_SIGNAL (1u << 0)
+#define TELEMETRY_FLAG_BUFFERING (1u << 1)
+#define TELEMETRY_FLAG_VGA (1u << 2)
+
+typedef struct __attribute__((packed)) telemetry_packet_t
+{
+  uint16_t magic;
+  uint8_t version;
+  uint8_t size; // bytes including the CRC
+  uint32_t seq;
+  uint32_t time_us;
+  // frame counters
+  uint32_t in_frames;
+  uint32_t out_frames;
+  uint32_t frames_dropped;
+  uint32_t frames_repeated;
+  // measured sync timing
+  uint32_t cap_samples;
+  uint16_t frame_lines;
+  uint16_t skipped; // packets not sent because the USB buffer was full
+  uint32_t frame_us;
+  // ISR cycles (SysTick, system clock)
+  uint32_t cap_isr_cycles;
+  uint32_t out_isr_cycles;
+  uint32_t sys_clk_khz;
+  uint32_t health[5]; // health_event_id_t order
+  // buffer state
+  uint8_t buf_in_idx;
+  uint8_t buf_out_idx;
+  uint8_t buf_free; // bit i: v_buf i free for capture
+  uint8_t flags;
+  uint32_t crc; // CRC-32 (IEEE) of all preceding bytes
+} telemetry_packet_t;
+
+uint32_t crc32_update(uint32_t crc, const void *data, uint32_t len);
+void telemetry_start(uint8_t rate);
+void telemetry_stop();
+bool telemetry_active();
+void telemetry_update();
\ No newline at end of file
@@ -0,0 +1,160 @@
+// TMDS (DVI 1.0) symbols and the serialised palette entries of the DVI output
+// plain C without SDK calls, so it also builds on the host (tools/tmds_test)
+#include "g_config.h"
+#include "tmds.h"
+
+uint64_t get_ser_diff_data(uint16_t dataR, uint16_t dataG, uint16_t dataB)
+{
+  uint64_t out64 = 0;
+  uint8_t d6;
+  uint8_t bR;
+  uint8_t bG;
+  uint8_t bB;
+
+  for (int i = 0; i < 10; i++)
+  {
+    out64 <<= 6;
+
+    if (i == 5)
+      out64 <<= 2;
+
+    bR = (dataR >> (9 - i)) & 1;
+    bG = (dataG >> (9 - i)) & 1;
+    bB = (dataB >> (9 - i)) & 1;
+
+#ifndef DVI_PINS_REVERSED
+    bR = 2 - bR;
+    bG = 2 - bG;
+    bB = 2 - bB;
+
+    d6 = (bB << 4) | (bG << 2) | (bR << 0);
+#else
+    bR = bR + 1;
+    bG = bG + 1;
+    bB = bB + 1;
+
+    d6 = (bR << 4) | (bG << 2) | (bB << 0);
+#endif
+
+    out64 |= d6;
+  }
+
+  return out64;
+}
+
+// TMDS transition minimization stage: XOR (xnor == false) or XNOR (xnor == true) chain, bit 8 flags XOR
+static uint16_t tmds_transition_minimize(uint8_t d8, bool xnor)
+{
+  uint16_t q_m = d8 & 1;
+
+  for (int i = 1; i < 8; i++)
+  {
+    uint16_t bit = ((q_m >> (i - 1)) ^ (d8 >> i)) & 1;
+    q_m |= (bit ^ xnor) << i;
+  }
+
+  if (!xnor)
+    q_m |= 1u << 8;
+
+  return q_m;
+}
+
+// TMDS encoder (DVI 1.0, 3.3.3): 8b -> 10b with running disparity
+uint16_t tmds_encoder(uint8_t d8, int *disparity)
+{
+  int n1_d = __builtin_popcount(d8);
+  uint16_t q_m = tmds_transition_minimize(d8, (n1_d > 4) || ((n1_d == 4) && ((d8 & 1) == 0)));
+
+  int n1 = __builtin_popcount(q_m & 0xff);
+  int n0 = 8 - n1;
+  bool q_m8 = (q_m >> 8) & 1;
+
+  if ((*disparity == 0) || (n1 == n0))
+  {
+    if (q_m8)
+    {
+      *disparity += n1 - n0;
+      return q_m;
+    }
+
+    *disparity += n0 - n1;
+    return (~q_m & 0xff) | (1u << 9);
+  }
+
+  if ((*disparity > 0 && n1 > n0) || (*disparity < 0 && n0 > n1))
+  {
+    *disparity += 2 * q_m8 + n0 - n1;
+    return (~q_m & 0xff) | (q_m8 << 8) | (1u << 9);
+  }
+
+  *disparity += -2 * !q_m8 + n1 - n0;
+  return q_m;
+}
+
+// DC-balanced pair of TMDS symbols for one colour channel. The running disparity encoder run
+// twice from a balanced line is used when it comes back to zero, otherwise all valid encodings
+// of the value (XOR/XNOR, inverted or not) are searched for a pair with exactly 10 ones. Byte
+// values without a balanced pair are replaced by the nearest value that has one. Returns the
+// value the pair decodes to.
+uint8_t tmds_encode_pair(uint8_t d8, uint16_t sym[2])
+{
+  for (int delta = 0; delta < 8; delta++)
+    for (int sign = 1; sign >= -1; sign -= 2)
+    {
+      int v = d8 + sign * delta;
+
+      if (v < 0 || v > 255)
+        continue;
+
+      int disparity = 0;
+
+      sym[0] = tmds_encoder(v, &disparity);
+      sym[1] = tmds_encoder(v, &disparity);
+
+      if (disparity == 0)
+        return v;
+
+      uint16_t cand[4];
+
+      for (int xnor = 0; xnor < 2; xnor++)
+      {
+        uint16_t q_m = tmds_transition_minimize(v, xnor);
+        cand[xnor * 2] = q_m;
+        cand[xnor * 2 + 1] = (~q_m & 0xff) | (q_m & 0x100) | (1u << 9);
+      }
+
+      for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+          if (__builtin_popcount(cand[i]) + __builtin_popcount(cand[j]) == 10)
+          {
+            sym[0] = cand[i];
+            sym[1] = cand[j];
+            return v;
+          }
+
+      if (delta == 0)
+        break;
+    }
+
+  // not reached: every byte value has a balanced neighbour within 2 steps
+  int disparity = 0;
+  sym[0] = sym[1] = tmds_encoder(d8, &disparity);
+  return d8;
+}
+
+// build palette of DC-balanced TMDS symbol pairs from 0xRRGGBB colours, two entries per colour
+void tmds_palette_init(uint64_t *pal, const uint32_t *rgb, int count)
+{
+  for (int c = 0; c < count; c++)
+  {
+    uint16_t R[2], G[2], B[2];
+
+    tmds_encode_pair((rgb[c] >> 16) & 0xff, R);
+    tmds_encode_pair((rgb[c] >> 8) & 0xff, G);
+    tmds_encode_pair((rgb[c] >> 0) & 0xff, B);
+
+    pal[c * 2] = get_ser_diff_data(R[0], G[0], B[0]);
+    pal[c * 2 + 1] = get_ser_diff_data(R[1], G[1], B[1]);
+  }
+}
+
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+// 10-bit TMDS symbols of the three channels -> one 64-bit word of the DVI serialiser (differential pairs, 2 bits per lane)
+uint64_t get_ser_diff_data(uint16_t dataR, uint16_t dataG, uint16_t dataB);
+uint16_t tmds_encoder(uint8_t d8, int *disparity);
+uint8_t tmds_encode_pair(uint8_t d8, uint16_t sym[2]);
+void tmds_palette_init(uint64_t *pal, const uint32_t *rgb, int count);
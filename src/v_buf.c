@@ -11,9 +11,18 @@ volatile bool buf_is_free[] = {false, true, true};
 
 volatile uint8_t v_buf_in_idx = 0;  // Buffer index for capture (written in ISR)
 volatile uint8_t v_buf_out_idx = 0; // Buffer index for display
+volatile uint8_t v_buf_prev_idx = 0; // Buffer displayed before the current one (frame blending)
+
+// statistics: captured frames without a free buffer, output frames without a new buffer
+volatile uint32_t frames_dropped = 0;
+volatile uint32_t frames_repeated = 0;
 
 bool buffering_mode = false;
 bool first_frame = true;
+// frame grabber: the output stays on its buffer, capture continues into the other two
+static volatile bool v_buf_pinned = false;
+// frame blending: the buffer shown before the current one is not given to capture
+static bool v_buf_keep_prev = false;
 
 // Optimized index increment for triple buffer (replaces expensive modulo)
 static inline uint8_t next_buf_idx(uint8_t idx)
@@ -21,33 +30,63 @@ static inline uint8_t next_buf_idx(uint8_t idx)
   return (idx == 2) ? 0 : idx + 1;
 }
 
+// the output moves on to buffer next; with frame blending the buffer it leaves stays reserved as the
+// previous frame and the one before goes back to capture
+static inline void *__not_in_flash_func(advance_v_buf_out)(uint8_t next)
+{
+  if (!v_buf_keep_prev)
+    buf_is_free[v_buf_out_idx] = true; // Mark current as free for capture
+  else if (v_buf_prev_idx != v_buf_out_idx)
+    buf_is_free[v_buf_prev_idx] = true;
+
+  v_buf_prev_idx = v_buf_out_idx;
+  v_buf_out_idx = next;
+  return v_bufs[next];
+}
+
 void *__not_in_flash_func(get_v_buf_out)()
 {
   if (!buffering_mode || first_frame)
     return v_bufs[0];
 
-  // Try next buffer
+  if (v_buf_pinned)
+    return v_bufs[v_buf_out_idx];
+
+  // Try next buffer, the reserved previous frame holds no new data
   uint8_t next = next_buf_idx(v_buf_out_idx);
-  if (!buf_is_free[next]) // Buffer has fresh data
-  {
-    buf_is_free[v_buf_out_idx] = true; // Mark current as free for capture
-    v_buf_out_idx = next;
-    return v_bufs[next];
-  }
+  if (!buf_is_free[next] && !(v_buf_keep_prev && next == v_buf_prev_idx)) // Buffer has fresh data
+    return advance_v_buf_out(next);
 
   // Try buffer after next
   next = next_buf_idx(next);
-  if (!buf_is_free[next]) // Buffer has fresh data
-  {
-    buf_is_free[v_buf_out_idx] = true; // Mark current as free for capture
-    v_buf_out_idx = next;
-    return v_bufs[next];
-  }
+  if (!buf_is_free[next] && !(v_buf_keep_prev && next == v_buf_prev_idx)) // Buffer has fresh data
+    return advance_v_buf_out(next);
 
   // No new buffer available, keep current
+  frames_repeated++;
   return v_bufs[v_buf_out_idx];
 }
 
+// previous frame for frame blending, reserved by set_v_buf_keep_prev() so capture can not overwrite it
+void *__not_in_flash_func(get_v_buf_prev)()
+{
+  if (!buffering_mode || first_frame)
+    return v_bufs[0];
+
+  return v_bufs[v_buf_prev_idx];
+}
+
+// frame blending on: the output keeps the frame it left from capture, capture is left with one buffer
+// called while the output is stopped, the previous frame starts as the shown one
+void set_v_buf_keep_prev(bool keep)
+{
+  if (v_buf_keep_prev && !keep && v_buf_prev_idx != v_buf_out_idx)
+    buf_is_free[v_buf_prev_idx] = true;
+
+  v_buf_prev_idx = v_buf_out_idx;
+  v_buf_keep_prev = keep;
+}
+
 void *__not_in_flash_func(get_v_buf_in)()
 {
   if (!buffering_mode)
@@ -74,9 +113,58 @@ void *__not_in_flash_func(get_v_buf_in)()
 
   // No free buffer available (display hasn't consumed any buffers yet)
   // This is normal during heavy load - capture will skip this frame
+  frames_dropped++;
   return NULL;
 }
 
+// buffer capture writes to (or last wrote to)
+void *__not_in_flash_func(get_v_buf_in_cur)()
+{
+  if (!buffering_mode)
+    return v_bufs[0];
+
+  return v_bufs[v_buf_in_idx];
+}
+
+// pin the displayed frame so it can be read without tearing, NULL without triple buffering
+// the output ISR may run between the two statements: it sees v_buf_pinned set first and stays on its buffer,
+// so the index read after it is the pinned one
+void *v_buf_pin()
+{
+  if (!buffering_mode || first_frame)
+    return NULL;
+
+  v_buf_pinned = true;
+  return v_bufs[v_buf_out_idx];
+}
+
+void v_buf_unpin()
+{
+  v_buf_pinned = false;
+}
+
+// buffer the output shows now; with triple buffering capture does not write it until the output moves on
+void *get_v_buf_shown()
+{
+  if (!buffering_mode || first_frame)
+    return v_bufs[0];
+
+  return v_bufs[v_buf_out_idx];
+}
+
+// frame blending skips lines that are the same in both frames, lines start word-aligned
+bool __not_in_flash_func(v_buf_line_changed)(const uint8_t *line, const uint8_t *prev, int16_t bytes)
+{
+  const uint32_t *a = (const uint32_t *)line;
+  const uint32_t *b = (const uint32_t *)prev;
+
+  for (int x = (bytes + 3) / 4; x--;)
+    if (*a++ != *b++)
+      return true;
+
+  return false;
+}
+
 void set_buffering_mode(bool buf_mode)
 {
   buffering_mode = buf_mode;
@@ -90,6 +178,7 @@ void clear_video_buffers()
   // Reset buffer indices
   v_buf_in_idx = 0;
   v_buf_out_idx = 0;
+  v_buf_prev_idx = 0;
 
   // Initialize buffer states
   // Buffer 0: ready for display (capture will write here first)
@@ -1,6 +1,20 @@
 #pragma once
 
+extern volatile uint32_t frames_dropped;
+extern volatile uint32_t frames_repeated;
+extern volatile bool buf_is_free[];
+extern volatile uint8_t v_buf_in_idx;
+extern volatile uint8_t v_buf_out_idx;
+extern bool buffering_mode;
+
 void *get_v_buf_out();
+void *get_v_buf_prev();
+void set_v_buf_keep_prev(bool);
 void *get_v_buf_in();
+void *get_v_buf_in_cur();
+void *v_buf_pin();
+void v_buf_unpin();
+void *get_v_buf_shown();
+bool v_buf_line_changed(const uint8_t *, const uint8_t *, int16_t);
 void set_buffering_mode(bool);
 void clear_video_buffers();
\ No newline at end of file
@@ -7,7 +7,9 @@
 #include "g_config.h"
 #include "vga.h"
 #include "pio_programs.h"
+#include "rgb_capture.h"
 #include "v_buf.h"
+#include "video_output.h"
 
 #ifdef OSD_ENABLE
 #include "osd.h"
@@ -21,6 +23,9 @@
 #define G_LOW 0b00001000
 #define B_HIGH 0b00110000
 #define B_LOW 0b00100000
+#define R_DIM 0b00000001
+#define G_DIM 0b00000100
+#define B_DIM 0b00010000
 #else
 #define R_HIGH 0b00110000
 #define R_LOW 0b00100000
@@ -28,6 +33,9 @@
 #define G_LOW 0b00001000
 #define B_HIGH 0b00000011
 #define B_LOW 0b00000010
+#define R_DIM 0b00010000
+#define G_DIM 0b00000100
+#define B_DIM 0b00000001
 #endif
 
 // sync pulse patterns (positive polarity)
@@ -49,39 +57,457 @@ extern int16_t v_visible_area;
 extern int16_t v_margin;
 
 static bool scanlines_mode = false;
+static bool scanlines_dim = false; // scanline rows at half intensity instead of black
 
-static uint32_t *v_out_dma_buf[4];
+// fractional scaler
+typedef struct scaler_window_t
+{
+  uint16_t x; // first source pixel
+  uint16_t y; // first source line
+  uint16_t w;
+  uint16_t h;
+} scaler_window_t;
+
+// column and line maps are double-buffered: a new set is prepared on the main loop and switched in during vertical blanking
+typedef struct scaler_t
+{
+  int16_t src_bytes;            // captured line length the maps were built for
+  scaler_window_t win;          // scaled part of the captured frame
+  uint16_t units;               // width of the scaled image in PIO clocks
+  uint16_t margin;              // left margin in PIO clocks
+  int16_t v_margin;             // top margin in lines
+  int16_t lines;                // height of the scaled image in lines
+  uint16_t *col_map;            // source pixel for every PIO clock of the scaled image
+  uint8_t line_repeat[V_BUF_H]; // output lines per source line
+} scaler_t;
+
+static bool fit_mode = false;
+static uint8_t unit; // output pixels per PIO clock
+static scaler_t scalers[2];
+static scaler_t *volatile scaler = &scalers[0];
+static scaler_t *volatile scaler_next = NULL;
+static uint8_t fit_line[V_BUF_W] __attribute__((aligned(4))); // source line converted to PIO bytes, one per pixel
+
+// Scale2x (div 4 modes): every source pixel becomes 2x2 blocks of two PIO clocks and two lines
+static bool scale2x_mode = false;
+static uint8_t scale2x_pix[16]; // PIO byte of every 4-bit colour
+
+// Scale2x rules for one output half-line, index bits: C==N, C==F, N==B, B==F
+// C and B are the left and right neighbours, N the neighbour line on the side of the half-line, F the opposite line
+// bit 0: left output pixel takes N, bit 1: right output pixel takes B
+// in RAM, the output ISR reads it twice per source pixel
+static uint8_t scale2x_rule[16] = {0, 1, 0, 0, 2, 0, 2, 0, 0, 1, 0, 0, 0, 0, 0, 0};
+
+// frame blending: [dimmed][line parity][current << 4 | previous colour] -> PIO bytes for an even (low byte) and an odd pixel
+static bool blend_mode = false;
+static uint16_t blend_lut[1024];
+static uint8_t *prev_buffer = NULL;
+
+// line render time in system clock cycles (SysTick), maximum since the last read, lines with OSD apart
+static volatile uint32_t render_cycles_max = 0;
+static volatile uint32_t render_cycles_osd_max = 0;
+static bool render_osd_line = false;
+
+// border-crop zoom
+static uint8_t *volatile scr_buffer = NULL;
+// NO SIGNAL screen instead of the captured frame, latched at the start of every output frame
+static bool show_no_signal = false;
+
+static uint32_t *v_out_dma_buf[5];
 // 2KB-aligned palette for better cache performance (compile-time alignment)
 static uint16_t palette[256] __attribute__((aligned(2048)));
+// dimmed scanline rows: bright colours at the LOW level, normal colours at the D0-only level
+static uint16_t palette_dim[256];
+#ifdef OSD_ENABLE
+// translucent OSD: the picture behind OSD background pixels, every lit channel at the D0-only level
+static uint16_t palette_osd_bg[256];
+// translucent OSD inside the box: [dimmed][OSD colour << 4 | picture colour] -> PIO byte of one pixel,
+// the picture through palette_osd_bg where the OSD pixel is OSD_COLOR_BACKGROUND
+static uint8_t osd_mix_pix[512];
+// Scale2x: PIO byte of every colour behind a translucent OSD, and the OSD line at twice the resolution
+static uint8_t osd_bg_pix[16];
+static uint16_t osd_2x_bits[OSD_LINE_COLUMNS];
+static uint8_t osd_2x_colors[OSD_LINE_COLUMNS];
+#endif
+// sync polarity the palettes and the blend table were built for, they are rebuilt only when it changes
+static int16_t palette_polarity = -1;
+// current output line, a restart begins at the vertical blanking so the monitor gets a whole frame right away
+static uint16_t out_y = 0;
 
 void __not_in_flash_func(memset32)(uint32_t *dst, const uint32_t data, uint32_t size);
 
-void __not_in_flash_func(dma_handler_vga)()
+// convert h_visible_area bytes of the captured line to pairs of PIO bytes, OSD is composited here
+// with prev_line the line is mixed with the previous frame, pal selects the normal or the dimmed palette
+static uint16_t *__not_in_flash_func(render_line)(uint16_t *line_buf, uint8_t *scr_line, const uint8_t *prev_line, const uint16_t *pal, uint16_t scaled_y)
+{
+#ifdef OSD_ENABLE
+  // main image area with OSD compositing
+  bool osd_active = osd_state.visible && (scaled_y >= osd_mode.start_y && scaled_y < osd_mode.end_y);
+
+  if (osd_active)
+  { // OSD line at scaled coordinates (2 pixels per byte)
+    render_osd_line = true;
+
+    const uint8_t *osd_line = osd_line_pixels(scaled_y - osd_mode.start_y);
+    // translucent OSD: background pixels show the picture through a darkened palette
+    const uint16_t *bg_pal = settings.osd_translucent ? palette_osd_bg : NULL;
+
+    int x = 0;
+
+    if (!osd_mode.full_width)
+    {
+      for (; (x + 4) <= osd_mode.start_x; x += 4)
+      { // ultra-fast direct byte processing for pre-OSD area with loop unrolling
+        *line_buf++ = pal[*scr_line++];
+        *line_buf++ = pal[*scr_line++];
+        *line_buf++ = pal[*scr_line++];
+        *line_buf++ = pal[*scr_line++];
+      }
+
+      for (; x < osd_mode.start_x; x++)
+        *line_buf++ = pal[*scr_line++];
+    }
+    else if (bg_pal != NULL)
+      for (; x < osd_mode.start_x; x++)
+        *line_buf++ = bg_pal[*scr_line++];
+    else
+      for (; x < osd_mode.start_x; x++)
+      {
+        *line_buf++ = pal[0];
+        scr_line++;
+      }
+
+    if (bg_pal != NULL)
+    { // one table load per pixel, indexed by the OSD and the picture colour
+      const uint8_t *mix = &osd_mix_pix[(pal == palette_dim) << 8];
+
+      for (; x < osd_mode.end_x; x++)
+      {
+        uint8_t o = *osd_line++;
+        uint8_t c = *scr_line++;
+
+        *line_buf++ = mix[((o & 0x0f) << 4) | (c & 0x0f)] | (mix[(o & 0xf0) | (c >> 4)] << 8);
+      }
+    }
+    else
+    {
+      for (; (x + 4) <= osd_mode.end_x; x += 4)
+      { // ultra-simplified OSD compositing with optimized unrolling
+        *line_buf++ = pal[*osd_line++];
+        *line_buf++ = pal[*osd_line++];
+        *line_buf++ = pal[*osd_line++];
+        *line_buf++ = pal[*osd_line++];
+        scr_line += 4;
+      }
+
+      for (; x < osd_mode.end_x; x++)
+      { // handle remaining bytes (0-3 bytes)
+        *line_buf++ = pal[*osd_line++];
+        scr_line++;
+      }
+    }
+
+    if (!osd_mode.full_width)
+    {
+      for (; (x + 4) <= h_visible_area; x += 4)
+      {
+        *line_buf++ = pal[*scr_line++];
+        *line_buf++ = pal[*scr_line++];
+        *line_buf++ = pal[*scr_line++];
+        *line_buf++ = pal[*scr_line++];
+      }
+
+      for (; x < h_visible_area; x++)
+        *line_buf++ = pal[*scr_line++];
+    }
+    else if (bg_pal != NULL)
+      for (; x < h_visible_area; x++)
+        *line_buf++ = bg_pal[*scr_line++];
+    else
+      for (; x < h_visible_area; x++)
+      {
+        *line_buf++ = pal[0];
+        scr_line++;
+      }
+  }
+  else
+  { // ultra-fast direct byte processing for non-OSD area with loop unrolling
+#endif
+    int x = 0;
+
+    if (prev_line != NULL)
+    { // frame blending: one table load per pixel, the dither phase alternates every source line
+      const uint16_t *lut = &blend_lut[((pal == palette_dim) << 9) | ((scaled_y & 1) << 8)];
+
+      for (; x < h_visible_area; x++)
+      {
+        uint8_t c = *scr_line++;
+        uint8_t p = *prev_line++;
+
+        *line_buf++ = (lut[((c & 0x0f) << 4) | (p & 0x0f)] & 0x00ff) | (lut[(c & 0xf0) | (p >> 4)] & 0xff00);
+      }
+    }
+
+    for (; (x + 4) <= h_visible_area; x += 4)
+    {
+      *line_buf++ = pal[*scr_line++];
+      *line_buf++ = pal[*scr_line++];
+      *line_buf++ = pal[*scr_line++];
+      *line_buf++ = pal[*scr_line++];
+    }
+
+    for (; x < h_visible_area; x++)
+      *line_buf++ = pal[*scr_line++];
+#ifdef OSD_ENABLE
+  }
+#endif
+
+  return line_buf;
+}
+
+// column map: fixed point step through the source window, sampling the middle of every PIO clock
+// line map: output lines for every source line of the window, zero outside of it
+static void scaler_setup(scaler_t *s, const scaler_window_t *win, int16_t src_bytes)
+{
+  uint16_t h_units = video_mode.h_visible_area / unit;
+  uint32_t src_w = src_bytes * 2;
+  uint32_t aspect_w = win->w * FIT_ASPECT_W; // window width in square pixels, multiplied by src_w
+
+  // the largest 4:3-correct size that fits the screen
+  uint32_t lines = video_mode.v_visible_area;
+  uint32_t width = lines * aspect_w / (src_w * win->h);
+
+  if (width > video_mode.h_visible_area)
+  {
+    width = video_mode.h_visible_area;
+    lines = width * src_w * win->h / aspect_w;
+  }
+
+  s->src_bytes = src_bytes;
+  s->win = *win;
+  s->units = width / unit;
+
+  if (s->units > h_units)
+    s->units = h_units;
+
+  s->margin = (h_units - s->units) / 2;
+  s->lines = lines;
+  s->v_margin = (video_mode.v_visible_area - lines) / 2;
+
+  uint32_t step = ((uint32_t)win->w << 16) / s->units;
+  uint32_t pos = ((uint32_t)win->x << 16) + step / 2;
+
+  for (int x = 0; x < s->units; x++, pos += step)
+    s->col_map[x] = pos >> 16;
+
+  memset(s->line_repeat, 0, V_BUF_H);
+
+  for (int i = 0; i < win->h; i++)
+    s->line_repeat[win->y + i] = ((i + 1) * lines) / win->h - (i * lines) / win->h;
+}
+
+static void __not_in_flash_func(render_fit_line)(const scaler_t *s, uint32_t *line_buf, uint8_t *scr_line, const uint8_t *prev_line, uint16_t scaled_y)
+{
+  render_line((uint16_t *)fit_line, scr_line, prev_line, palette, scaled_y);
+
+  uint8_t *out = (uint8_t *)line_buf + s->margin;
+  const uint16_t *map = s->col_map;
+  int x = s->units;
+
+  for (; x >= 4; x -= 4)
+  {
+    *out++ = fit_line[*map++];
+    *out++ = fit_line[*map++];
+    *out++ = fit_line[*map++];
+    *out++ = fit_line[*map++];
+  }
+
+  for (; x > 0; x--)
+    *out++ = fit_line[*map++];
+}
+
+#ifdef OSD_ENABLE
+// OSD window of a Scale2x half-line: one glyph sub-pixel per PIO clock and half-line (16x16 glyphs in the 8x8 cells)
+static void __not_in_flash_func(render_osd_2x)(uint8_t *out, const uint8_t *cur, uint16_t scaled_y, uint8_t half)
+{
+  uint8_t cells = osd_line_2x(scaled_y - osd_mode.start_y, half, osd_2x_bits, osd_2x_colors);
+  bool see_through = settings.osd_translucent;
+
+  out += osd_mode.start_x * 4;
+  cur += osd_mode.start_x;
+
+  for (uint8_t col = 0; col < cells; col++, cur += OSD_FONT_WIDTH / 2)
+  {
+    uint16_t bits = osd_2x_bits[col];
+    uint8_t fg = osd_2x_colors[col] >> 4;
+    uint8_t bg = osd_2x_colors[col] & 0x0f;
+
+    for (int i = 0; i < OSD_FONT_WIDTH * 2; i++, bits <<= 1)
+    {
+      uint8_t c = (bits & 0x8000) ? fg : bg;
+
+      if (see_through && c == OSD_COLOR_BACKGROUND)
+      { // sub-pixel i covers half of source pixel i / 2
+        uint8_t s = cur[i >> 2];
+
+        *out++ = osd_bg_pix[(i & 2) ? s >> 4 : s & 0x0f];
+      }
+      else
+        *out++ = scale2x_pix[c];
+    }
+  }
+}
+#endif
+
+// one output half-line of a Scale2x source line: near is the source line on the side of the half-line, far the opposite one
+// half: 0 upper, 1 lower half-line
+static void __not_in_flash_func(render_scale2x_line)(uint8_t *out, const uint8_t *cur, const uint8_t *near, const uint8_t *far, uint16_t scaled_y, uint8_t half)
+{
+  uint8_t black = scale2x_pix[0];
+
+  for (int x = h_margin * 4; x--;)
+    *out++ = black;
+
+#ifdef OSD_ENABLE
+  if (osd_state.visible && (scaled_y >= osd_mode.start_y && scaled_y < osd_mode.end_y))
+  { // the picture of OSD lines is not smoothed: composite as usual, repeat every PIO byte, then draw the OSD window at PIO clock resolution
+    render_line((uint16_t *)fit_line, (uint8_t *)cur, NULL, palette, scaled_y);
+
+    for (int x = 0; x < h_visible_area * 2; x++)
+    {
+      out[2 * x] = fit_line[x];
+      out[2 * x + 1] = fit_line[x];
+    }
+
+    render_osd_2x(out, cur, scaled_y, half);
+    out += h_visible_area * 4;
+  }
+  else
+#endif
+  {
+    uint8_t c = cur[0] & 0x0f; // left neighbour, the edge pixel repeats itself
+
+    for (int x = 0; x < h_visible_area; x++)
+    {
+      uint8_t s = cur[x];
+      uint8_t n = near[x];
+      uint8_t f = far[x];
+      uint8_t p0 = s & 0x0f;
+      uint8_t p1 = s >> 4;
+
+      if (n == f)
+      { // no rule fires when both neighbour lines agree
+        out[0] = out[1] = scale2x_pix[p0];
+        out[2] = out[3] = scale2x_pix[p1];
+        out += 4;
+        c = p1;
+        continue;
+      }
+
+      uint8_t n0 = n & 0x0f;
+      uint8_t f0 = f & 0x0f;
+      uint8_t rule = scale2x_rule[(c == n0) | ((c == f0) << 1) | ((n0 == p1) << 2) | ((p1 == f0) << 3)];
+
+      *out++ = scale2x_pix[(rule & 1) ? n0 : p0];
+      *out++ = scale2x_pix[(rule & 2) ? p1 : p0];
+
+      uint8_t n1 = n >> 4;
+      uint8_t f1 = f >> 4;
+      uint8_t b = (x + 1 < h_visible_area) ? (cur[x + 1] & 0x0f) : p1;
+
+      rule = scale2x_rule[(p0 == n1) | ((p0 == f1) << 1) | ((n1 == b) << 2) | ((b == f1) << 3)];
+
+      *out++ = scale2x_pix[(rule & 1) ? n1 : p1];
+      *out++ = scale2x_pix[(rule & 2) ? b : p1];
+
+      c = p1;
+    }
+  }
+
+  for (int x = h_margin * 4; x--;)
+    *out++ = black;
+}
+
+// source line y of the shown frame
+static inline uint8_t *__not_in_flash_func(get_scr_line)(int16_t y)
+{
+  if (show_no_signal)
+    return get_no_signal_line(y);
+
+  return &scr_buffer[y * (V_BUF_W / 2)];
+}
+
+// previous frame line for blending, NULL when blending is off or the line is the same in both frames
+static inline const uint8_t *__not_in_flash_func(get_blend_line)(uint8_t *scr_line)
 {
-  static uint16_t y = 0;
+  if (!blend_mode || show_no_signal || prev_buffer == scr_buffer)
+    return NULL;
 
-  static uint8_t *scr_buffer = NULL;
+  const uint8_t *prev_line = prev_buffer + (scr_line - scr_buffer);
+
+  return v_buf_line_changed(scr_line, prev_line, h_visible_area) ? prev_line : NULL;
+}
+
+static inline void __not_in_flash_func(account_render_cycles)(uint32_t start)
+{
+  uint32_t cycles = (start - systick_hw->cvr) & 0x00ffffff;
+
+  if (render_osd_line)
+  {
+    render_osd_line = false;
+
+    if (cycles > render_cycles_osd_max)
+      render_cycles_osd_max = cycles;
+  }
+  else if (cycles > render_cycles_max)
+    render_cycles_max = cycles;
+
+  out_isr_cycles += cycles;
+}
+
+void __not_in_flash_func(dma_handler_vga)()
+{
+  uint32_t start = systick_hw->cvr;
 
   dma_hw->ints0 = 1u << dma_ch1;
 
-  y++;
+  uint16_t y = ++out_y;
 
   if (y == video_mode.whole_frame)
   {
-    y = 0;
+    y = out_y = 0;
+    mark_video_output_frame();
     scr_buffer = get_v_buf_out();
+    prev_buffer = get_v_buf_prev();
+    show_no_signal = no_signal;
+#ifdef OSD_ENABLE
+    osd_vblank();
+#endif
   }
 
   if (y >= video_mode.v_visible_area && y < (video_mode.v_visible_area + video_mode.v_front_porch))
   {
     // vertical sync front porch
     dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[0], false);
+
     return;
   }
   else if (y >= (video_mode.v_visible_area + video_mode.v_front_porch) && y < (video_mode.v_visible_area + video_mode.v_front_porch + video_mode.v_sync_pulse))
   {
     // vertical sync pulse
     dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[1], false);
+
+    // switch to the scaler maps prepared by update_vga_scaler(), the image area of both line buffers is cleared for the new margins
+    if (fit_mode && y == (video_mode.v_visible_area + video_mode.v_front_porch) && scaler_next != NULL)
+    {
+      scaler = scaler_next;
+      scaler_next = NULL;
+      h_visible_area = scaler->src_bytes;
+
+      memcpy(v_out_dma_buf[2], v_out_dma_buf[0], video_mode.h_visible_area / unit);
+      memcpy(v_out_dma_buf[3], v_out_dma_buf[0], video_mode.h_visible_area / unit);
+    }
+
     return;
   }
   else if (y >= (video_mode.v_visible_area + video_mode.v_front_porch + video_mode.v_sync_pulse) && y < video_mode.whole_frame)
@@ -104,6 +530,92 @@ void __not_in_flash_func(dma_handler_vga)()
     return;
   }
 
+  if (fit_mode)
+  {
+    static int16_t fit_y;
+    static uint8_t fit_repeat;
+    static int fit_buf_idx = 2;
+    const scaler_t *s = scaler;
+
+    if (y < s->v_margin || y >= (s->v_margin + s->lines))
+    {
+      dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[0], false);
+      return;
+    }
+
+    if (y == s->v_margin)
+    { // first line of the image
+      fit_y = s->win.y - 1;
+      fit_repeat = 0;
+    }
+
+    if (fit_repeat == 0)
+    { // next source line, rendered into the image buffer that is not on screen
+      do
+        fit_y++;
+      while (s->line_repeat[fit_y] == 0 && fit_y < V_BUF_H - 1);
+
+      fit_repeat = s->line_repeat[fit_y];
+      fit_buf_idx ^= 1;
+
+      uint8_t *scr_line = get_scr_line(fit_y);
+
+      render_fit_line(s, v_out_dma_buf[fit_buf_idx], scr_line, get_blend_line(scr_line), fit_y);
+      account_render_cycles(start);
+    }
+
+    fit_repeat--;
+    dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[fit_buf_idx], false);
+    return;
+  }
+
+  if (scale2x_mode)
+  { // top half-line of a source line on lines 0-1, bottom half on lines 2-3
+    // each half is rendered while the other buffer is on screen, two lines before it is needed
+    uint16_t scaled_y = (y - v_margin) / 4;
+    uint8_t *cur = get_scr_line(scaled_y);
+    uint8_t *prev = (scaled_y > 0) ? get_scr_line(scaled_y - 1) : cur;
+    uint8_t *next = (scaled_y < V_BUF_H - 1) ? get_scr_line(scaled_y + 1) : cur;
+
+    switch ((y - v_margin) % 4)
+    {
+    case 0:
+      if (y == v_margin)
+      { // first line of the image, nothing rendered ahead
+        render_scale2x_line((uint8_t *)v_out_dma_buf[2], cur, prev, next, scaled_y, 0);
+        account_render_cycles(start);
+      }
+
+      dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[2], false);
+      break;
+
+    case 1:
+      dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[2], false);
+      render_scale2x_line((uint8_t *)v_out_dma_buf[3], cur, next, prev, scaled_y, 1);
+      account_render_cycles(start);
+      break;
+
+    case 2:
+      dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[3], false);
+      break;
+
+    case 3:
+      dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[3], false);
+
+      if (y + 1 < v_visible_area + v_margin && scaled_y < V_BUF_H - 1)
+      {
+        uint8_t *next2 = (scaled_y < V_BUF_H - 2) ? get_scr_line(scaled_y + 2) : next;
+
+        render_scale2x_line((uint8_t *)v_out_dma_buf[2], next, cur, next2, scaled_y + 1, 0);
+        account_render_cycles(start);
+      }
+
+      break;
+    }
+
+    return;
+  }
+
   // image area
   uint8_t line = y % (2 * video_mode.div);
 
@@ -112,6 +624,10 @@ void __not_in_flash_func(dma_handler_vga)()
   case 2:
 #ifdef SCANLINES_ENABLE_LOW_RES
     if (scanlines_mode)
+#else
+    // black scanlines make the 640x480 and 800x600 image too dark, dimmed ones are available
+    if (scanlines_mode && scanlines_dim)
+#endif
     {
       if (line > 0)
         line++;
@@ -122,11 +638,6 @@ void __not_in_flash_func(dma_handler_vga)()
     else if (line > 1)
       line++;
 
-#else
-    if (line > 1)
-      line++;
-
-#endif
     break;
 
   case 3:
@@ -170,6 +681,7 @@ void __not_in_flash_func(dma_handler_vga)()
   }
 
   int active_buf_idx;
+  bool dim = false;
 
   switch (line)
   {
@@ -182,8 +694,17 @@ void __not_in_flash_func(dma_handler_vga)()
     return;
 
   case 2:
-    dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[0], false);
-    return;
+  case 5:
+    // scanline row: blank line or the same line through the dimmed palette into its own buffer
+    if (!scanlines_dim)
+    {
+      dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[0], false);
+      return;
+    }
+
+    active_buf_idx = 4;
+    dim = true;
+    break;
 
   case 3:
     active_buf_idx = 3;
@@ -193,128 +714,223 @@ void __not_in_flash_func(dma_handler_vga)()
     dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[3], false);
     return;
 
-  case 5:
-    dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[0], false);
-    return;
-
   default:
     return;
   }
 
   uint16_t scaled_y = (y - v_margin) / video_mode.div; // represents the line in the original captured image
-  uint8_t *scr_line = &scr_buffer[scaled_y * (V_BUF_W / 2)];
+  uint8_t *scr_line = get_scr_line(scaled_y);
   uint16_t *line_buf = (uint16_t *)v_out_dma_buf[active_buf_idx];
 
   // left margin
   for (int x = h_margin; x--;)
     *line_buf++ = palette[0];
 
-#ifdef OSD_ENABLE
-  // main image area with OSD compositing
-  bool osd_active = osd_state.visible && (scaled_y >= osd_mode.start_y && scaled_y < osd_mode.end_y);
-
-  if (osd_active)
-  { // calculate OSD buffer line offset using scaled coordinates (2 pixels per byte)
-    uint8_t *osd_line = &osd_buffer[(scaled_y - osd_mode.start_y) * (osd_mode.width / 2)];
+  line_buf = render_line(line_buf, scr_line, get_blend_line(scr_line), dim ? palette_dim : palette, scaled_y);
 
-    int x = 0;
+  // right margin
+  for (int x = h_margin; x--;)
+    *line_buf++ = palette[0];
 
-    if (!osd_mode.full_width)
-    {
-      for (; (x + 4) <= osd_mode.start_x; x += 4)
-      { // ultra-fast direct byte processing for pre-OSD area with loop unrolling
-        *line_buf++ = palette[*scr_line++];
-        *line_buf++ = palette[*scr_line++];
-        *line_buf++ = palette[*scr_line++];
-        *line_buf++ = palette[*scr_line++];
-      }
+  dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[active_buf_idx], false);
+  account_render_cycles(start);
+}
 
-      for (; x < osd_mode.start_x; x++)
-        *line_buf++ = palette[*scr_line++];
-    }
-    else
-      for (; x < osd_mode.start_x; x++)
-      {
-        *line_buf++ = palette[0];
-        scr_line++;
-      }
+void set_vga_scanlines_mode(bool sl_mode, bool dim)
+{
+  scanlines_mode = sl_mode;
+  scanlines_dim = dim;
+}
 
-    for (; (x + 4) <= osd_mode.end_x; x += 4)
-    { // ultra-simplified OSD compositing with optimized unrolling
-      *line_buf++ = palette[*osd_line++];
-      *line_buf++ = palette[*osd_line++];
-      *line_buf++ = palette[*osd_line++];
-      *line_buf++ = palette[*osd_line++];
-      scr_line += 4;
-    }
+// most common non-black colour of the first and last lines, black when there is little of it (blanking or black border)
+static uint8_t detect_border_colour(const uint8_t *buf, int16_t src_bytes)
+{
+  uint16_t count[16] = {0};
+  uint16_t samples = 0;
 
-    for (; x < osd_mode.end_x; x++)
-    { // handle remaining bytes (0-3 bytes)
-      *line_buf++ = palette[*osd_line++];
-      scr_line++;
-    }
+  for (int y = 0; y < 8; y++)
+  {
+    const uint8_t *top = &buf[y * (V_BUF_W / 2)];
+    const uint8_t *bottom = &buf[(V_BUF_H - 1 - y) * (V_BUF_W / 2)];
 
-    if (!osd_mode.full_width)
+    for (int x = 0; x < src_bytes; x += 2, samples += 4)
     {
-      for (; (x + 4) <= h_visible_area; x += 4)
-      {
-        *line_buf++ = palette[*scr_line++];
-        *line_buf++ = palette[*scr_line++];
-        *line_buf++ = palette[*scr_line++];
-        *line_buf++ = palette[*scr_line++];
-      }
-
-      for (; x < h_visible_area; x++)
-        *line_buf++ = palette[*scr_line++];
+      count[top[x] & 0x0f]++;
+      count[top[x] >> 4]++;
+      count[bottom[x] & 0x0f]++;
+      count[bottom[x] >> 4]++;
     }
-    else
-      for (; x < h_visible_area; x++)
-      {
-        *line_buf++ = palette[0];
-        scr_line++;
-      }
   }
-  else
-  { // ultra-fast direct byte processing for non-OSD area with loop unrolling
-#endif
+
+  uint8_t colour = 0;
+
+  for (int c = 1; c < 16; c++)
+    if (count[c] > count[colour] || (colour == 0 && count[c] >= samples / 4))
+      colour = c;
+
+  return colour;
+}
+
+// a line of border colour or of black capture blanking
+static bool is_border_line(const uint8_t *line, int16_t src_bytes, uint8_t border)
+{
+  uint8_t c = (line[0] == 0) ? 0 : border;
+
+  for (int x = 0; x < src_bytes; x++)
+    if (line[x] != c)
+      return false;
+
+  return true;
+}
+
+// centre a window side on the detected picture and grow it to the paper size
+static void grow_window(uint16_t *pos, uint16_t *size, uint16_t min_size, uint16_t limit)
+{
+  if (*size >= min_size)
+    return;
+
+  int p = *pos - (min_size - *size) / 2;
+
+  if (p > limit - min_size)
+    p = limit - min_size;
+
+  if (p < 0)
+    p = 0;
+
+  *pos = p;
+  *size = min_size;
+}
+
+// picture rectangle of the captured frame: bounding box of everything that is not border or black blanking
+// black paper next to the border counts as picture, so the box is found even when only a few characters are printed
+static bool detect_paper(const uint8_t *buf, int16_t src_bytes, scaler_window_t *win)
+{
+  uint8_t c = detect_border_colour(buf, src_bytes);
+  uint8_t border = c | (c << 4);
+  int top = 0;
+  int bottom = V_BUF_H - 1;
+
+  while (top <= bottom && is_border_line(&buf[top * (V_BUF_W / 2)], src_bytes, border))
+    top++;
+
+  if (top > bottom)
+    return false;
+
+  while (is_border_line(&buf[bottom * (V_BUF_W / 2)], src_bytes, border))
+    bottom--;
+
+  int left = src_bytes;
+  int right = -1;
+
+  for (int y = top; y <= bottom; y++)
+  {
+    const uint8_t *line = &buf[y * (V_BUF_W / 2)];
     int x = 0;
 
-    for (; (x + 4) <= h_visible_area; x += 4)
-    {
-      *line_buf++ = palette[*scr_line++];
-      *line_buf++ = palette[*scr_line++];
-      *line_buf++ = palette[*scr_line++];
-      *line_buf++ = palette[*scr_line++];
-    }
+    while (x < left && line[x] == 0)
+      x++;
 
-    for (; x < h_visible_area; x++)
-      *line_buf++ = palette[*scr_line++];
-#ifdef OSD_ENABLE
+    while (x < left && line[x] == border)
+      x++;
+
+    left = x;
+    x = src_bytes - 1;
+
+    while (x > right && line[x] == 0)
+      x--;
+
+    while (x > right && line[x] == border)
+      x--;
+
+    right = x;
   }
-#endif
 
-  // right margin
-  for (int x = h_margin; x--;)
-    *line_buf++ = palette[0];
+  if (left > right)
+    return false;
 
-  dma_channel_set_read_addr(dma_ch1, &v_out_dma_buf[active_buf_idx], false);
+  uint16_t paper_w = ZOOM_PAPER_W * (settings.frequency / 1000) / (ZOOM_PAPER_FREQ / 1000);
+
+  if (paper_w > src_bytes * 2)
+    paper_w = src_bytes * 2;
+
+  win->x = left * 2;
+  win->w = (right - left + 1) * 2;
+  win->y = top;
+  win->h = bottom - top + 1;
+
+  grow_window(&win->x, &win->w, paper_w, src_bytes * 2);
+  grow_window(&win->y, &win->h, ZOOM_PAPER_H, V_BUF_H);
+
+  return true;
 }
 
-void set_vga_scanlines_mode(bool sl_mode)
+static bool window_near(const scaler_window_t *a, const scaler_window_t *b)
 {
-  scanlines_mode = sl_mode;
+  return abs(a->x - b->x) <= ZOOM_HYSTERESIS && abs(a->w - b->w) <= ZOOM_HYSTERESIS &&
+         abs(a->y - b->y) <= ZOOM_HYSTERESIS && abs(a->h - b->h) <= ZOOM_HYSTERESIS;
 }
 
-void start_vga()
+// called from the main loop: follows the capture frequency and, in zoom mode, the picture of the captured frame
+// new maps are built into the idle scaler and switched in by the output ISR during vertical blanking
+void update_vga_scaler()
 {
-  int whole_line = video_mode.whole_line / video_mode.div;
-  int h_sync_pulse_front = (video_mode.h_visible_area + video_mode.h_front_porch) / video_mode.div;
-  int h_sync_pulse = video_mode.h_sync_pulse / video_mode.div;
+  static uint32_t last_frame = 0;
+  static scaler_window_t candidate;
+  static uint8_t stable = 0;
+
+  if (!fit_mode || scaler_next != NULL || out_frame_count == last_frame)
+    return;
+
+  last_frame = out_frame_count;
+
+  const scaler_t *s = scaler;
+  int16_t src_bytes = (uint8_t)(settings.frequency / 1000000) * (ACTIVE_VIDEO_TIME / 2);
+  scaler_window_t win = {0, 0, src_bytes * 2, V_BUF_H};
+
+#ifdef OSD_ENABLE
+  // the OSD is placed in captured frame coordinates, the whole frame is shown while it is open
+  // and so is NO SIGNAL, its text is not in the captured picture
+  if (settings.scaling_mode == SCALE_ZOOM && !osd_state.visible && !no_signal)
+#else
+  if (settings.scaling_mode == SCALE_ZOOM && !no_signal)
+#endif
+  {
+    scaler_window_t found;
+
+    if (scr_buffer != NULL && detect_paper(scr_buffer, src_bytes, &found) && !window_near(&found, &s->win))
+    {
+      if (stable > 0 && window_near(&found, &candidate))
+        stable++;
+      else
+      {
+        candidate = found;
+        stable = 1;
+      }
+    }
+    else
+      stable = 0;
+
+    if (stable >= ZOOM_STABLE_FRAMES)
+    {
+      win = candidate;
+      stable = 0;
+    }
+    else if (s->win.x + s->win.w <= src_bytes * 2)
+      win = s->win;
+  }
+
+  if (src_bytes == s->src_bytes && memcmp(&win, &s->win, sizeof(win)) == 0)
+    return;
 
-  set_sys_clock_khz(video_mode.sys_freq, true);
-  sleep_ms(10);
+  scaler_t *next = (s == &scalers[0]) ? &scalers[1] : &scalers[0];
 
-  // palette initialization
+  scaler_setup(next, &win, src_bytes);
+  scaler_next = next;
+}
+
+// normal, dimmed (scanline) and translucent OSD palettes for the sync polarity of the current mode
+static void build_palettes()
+{
   for (int i = 0; i < 16; i++)
   {
     uint8_t Yi = (i >> 3) & 1;
@@ -333,6 +949,170 @@ void start_vga()
     }
   }
 
+  for (int i = 0; i < 16; i++)
+  {
+    uint8_t Yi = (i >> 3) & 1;
+    uint8_t Ri = ((i >> 2) & 1) ? (Yi ? R_LOW : R_DIM) : 0;
+    uint8_t Gi = ((i >> 1) & 1) ? (Yi ? G_LOW : G_DIM) : 0;
+    uint8_t Bi = ((i >> 0) & 1) ? (Yi ? B_LOW : B_DIM) : 0;
+
+    for (int j = 0; j < 16; j++)
+    {
+      uint8_t Yj = (j >> 3) & 1;
+      uint8_t Rj = ((j >> 2) & 1) ? (Yj ? R_LOW : R_DIM) : 0;
+      uint8_t Gj = ((j >> 1) & 1) ? (Yj ? G_LOW : G_DIM) : 0;
+      uint8_t Bj = ((j >> 0) & 1) ? (Yj ? B_LOW : B_DIM) : 0;
+
+      palette_dim[(i * 16) + j] = ((uint16_t)(Ri | Gi | Bi | (NO_SYNC ^ video_mode.sync_polarity)) << 8) | (Rj | Gj | Bj | (NO_SYNC ^ video_mode.sync_polarity));
+    }
+  }
+
+#ifdef OSD_ENABLE
+  for (int i = 0; i < 16; i++)
+  {
+    uint8_t Ri = ((i >> 2) & 1) ? R_DIM : 0;
+    uint8_t Gi = ((i >> 1) & 1) ? G_DIM : 0;
+    uint8_t Bi = ((i >> 0) & 1) ? B_DIM : 0;
+
+    for (int j = 0; j < 16; j++)
+    {
+      uint8_t Rj = ((j >> 2) & 1) ? R_DIM : 0;
+      uint8_t Gj = ((j >> 1) & 1) ? G_DIM : 0;
+      uint8_t Bj = ((j >> 0) & 1) ? B_DIM : 0;
+
+      palette_osd_bg[(i * 16) + j] = ((uint16_t)(Ri | Gi | Bi | (NO_SYNC ^ video_mode.sync_polarity)) << 8) | (Rj | Gj | Bj | (NO_SYNC ^ video_mode.sync_polarity));
+    }
+
+    osd_bg_pix[i] = palette_osd_bg[i] & 0xff;
+  }
+
+  for (int dim = 0; dim < 2; dim++)
+    for (int i = 0; i < 256; i++)
+      osd_mix_pix[(dim << 8) | i] = (i >> 4) == OSD_COLOR_BACKGROUND ? osd_bg_pix[i & 0x0f] : (dim ? palette_dim : palette)[i >> 4] & 0xff;
+#endif
+
+  for (int i = 0; i < 16; i++)
+    scale2x_pix[i] = palette[i] & 0xff;
+}
+
+// mixed colour of every pair of source colours on the 4-level DAC (off, D0 only, LOW, HIGH)
+// a channel half-way between two levels is dithered in a checkerboard pattern
+// the dimmed half mixes the scanline palette: every lit channel one level lower
+static void build_blend_lut()
+{
+  const uint8_t level_bit[3] = {B_HIGH / 3, G_HIGH / 3, R_HIGH / 3}; // weight of level 1 of every channel
+
+  for (int dim = 0; dim < 2; dim++)
+    for (int phase = 0; phase < 2; phase++)
+      for (int i = 0; i < 256; i++)
+      {
+        uint8_t a = i >> 4;
+        uint8_t b = i & 0x0f;
+        uint8_t out[2] = {NO_SYNC ^ video_mode.sync_polarity, NO_SYNC ^ video_mode.sync_polarity};
+
+        for (int ch = 0; ch < 3; ch++)
+        {
+          uint8_t sum = (((a >> ch) & 1) ? ((a & 8) ? 3 : 2) - dim : 0) + (((b >> ch) & 1) ? ((b & 8) ? 3 : 2) - dim : 0);
+
+          for (int x = 0; x < 2; x++)
+            out[x] |= ((sum + ((x ^ phase) & sum & 1)) / 2) * level_bit[ch];
+        }
+
+        blend_lut[(dim << 9) | (phase << 8) | i] = out[0] | (out[1] << 8);
+      }
+}
+
+uint8_t get_vga_unit(video_mode_t *v_mode, scaling_mode_t mode)
+{
+  // Scale2x splits every source pixel of a div 4 mode into two PIO clocks
+  if (mode == SCALE_2X && v_mode->div == 4)
+    return 2;
+
+  // the fractional scaler works with the finest PIO clock that keeps the divider integer and the line length in whole DMA words
+  if (mode == SCALE_FIT || mode == SCALE_ZOOM)
+    for (uint8_t u = 2; u < v_mode->div; u++)
+      if (((uint64_t)v_mode->sys_freq * 1000 * u) % (uint32_t)v_mode->pixel_freq == 0 && v_mode->whole_line % (u * 4) == 0)
+        return u;
+
+  return v_mode->div;
+}
+
+// system clock in kHz: Scale2x raises it to the next multiple of its PIO clock when the divider would be fractional
+// (1280x1024 d4: 2 PIO clocks per source pixel need 270 instead of 243 MHz)
+uint32_t get_vga_sys_freq(video_mode_t *v_mode, scaling_mode_t mode)
+{
+  uint32_t pio_freq = (uint32_t)v_mode->pixel_freq / get_vga_unit(v_mode, mode);
+
+  if (mode != SCALE_2X || ((uint64_t)v_mode->sys_freq * 1000) % pio_freq == 0 || pio_freq % 1000)
+    return v_mode->sys_freq;
+
+  return (v_mode->sys_freq / (pio_freq / 1000) + 1) * (pio_freq / 1000);
+}
+
+uint32_t get_vga_render_cycles()
+{
+  uint32_t cycles = render_cycles_max;
+
+  render_cycles_max = 0;
+
+  return cycles;
+}
+
+uint32_t get_vga_osd_render_cycles()
+{
+  uint32_t cycles = render_cycles_osd_max;
+
+  render_cycles_osd_max = 0;
+
+  return cycles;
+}
+
+uint32_t get_vga_render_budget(video_mode_t *v_mode, scaling_mode_t mode)
+{
+  // one line period, Scale2x renders two lines ahead
+  uint32_t cycles = (uint64_t)v_mode->whole_line * get_vga_sys_freq(v_mode, mode) * 1000 / (uint32_t)v_mode->pixel_freq;
+
+  return (mode == SCALE_2X && v_mode->div == 4) ? cycles * 2 : cycles;
+}
+
+void start_vga()
+{
+  fit_mode = (settings.scaling_mode == SCALE_FIT || settings.scaling_mode == SCALE_ZOOM);
+  scale2x_mode = (settings.scaling_mode == SCALE_2X && video_mode.div == 4);
+  unit = get_vga_unit(&video_mode, settings.scaling_mode);
+
+  int whole_line = video_mode.whole_line / unit;
+  int h_sync_pulse_front = (video_mode.h_visible_area + video_mode.h_front_porch) / unit;
+  int h_sync_pulse = video_mode.h_sync_pulse / unit;
+
+  video_mode.sys_freq = get_vga_sys_freq(&video_mode, settings.scaling_mode);
+
+  // PLL relock and settling only when the system clock changes
+  if (clock_get_hz(clk_sys) != video_mode.sys_freq * 1000)
+  {
+    set_sys_clock_khz(video_mode.sys_freq, true);
+    sleep_ms(10);
+  }
+
+  // Scale2x compares source colours, mixed colours would break its rules
+  blend_mode = settings.blend_mode && !scale2x_mode;
+  set_v_buf_keep_prev(blend_mode);
+
+  // palette initialization, only the sync polarity differs between modes
+  if (palette_polarity != video_mode.sync_polarity)
+  {
+    build_palettes();
+    build_blend_lut();
+    palette_polarity = video_mode.sync_polarity;
+  }
+
+  // SysTick on the system clock for the line render time
+  systick_hw->rvr = 0x00ffffff;
+  systick_hw->cvr = 0;
+  systick_hw->csr = 0x5;
+  render_cycles_max = 0;
+  render_cycles_osd_max = 0;
+
   // set VGA pins
   for (int i = VGA_PIN_D0; i < VGA_PIN_D0 + 8; i++)
   {
@@ -341,21 +1121,44 @@ void start_vga()
     gpio_set_slew_rate(i, GPIO_SLEW_RATE_SLOW);
   }
 
-  // allocate memory for line template definitions - individual allocations
+  // line buffers and scaler maps are carved from the static output arena
+  uint32_t *arena = g_out_buf;
+
+  for (int i = 0; i < 5; i++)
+  {
+    v_out_dma_buf[i] = arena;
+    arena += whole_line / 4;
+  }
+
   // empty line
-  v_out_dma_buf[0] = calloc(whole_line / 4, sizeof(uint32_t));
   memset((uint8_t *)v_out_dma_buf[0], (NO_SYNC ^ video_mode.sync_polarity), whole_line);
   memset((uint8_t *)v_out_dma_buf[0] + h_sync_pulse_front, (H_SYNC ^ video_mode.sync_polarity), h_sync_pulse);
   // vertical sync pulse
-  v_out_dma_buf[1] = calloc(whole_line / 4, sizeof(uint32_t));
   memset((uint8_t *)v_out_dma_buf[1], (V_SYNC ^ video_mode.sync_polarity), whole_line);
   memset((uint8_t *)v_out_dma_buf[1] + h_sync_pulse_front, (VH_SYNC ^ video_mode.sync_polarity), h_sync_pulse);
   // image line
-  v_out_dma_buf[2] = calloc(whole_line / 4, sizeof(uint32_t));
   memcpy((uint8_t *)v_out_dma_buf[2], (uint8_t *)v_out_dma_buf[0], whole_line);
   // image line
-  v_out_dma_buf[3] = calloc(whole_line / 4, sizeof(uint32_t));
   memcpy((uint8_t *)v_out_dma_buf[3], (uint8_t *)v_out_dma_buf[0], whole_line);
+  // dimmed scanline
+  memcpy((uint8_t *)v_out_dma_buf[4], (uint8_t *)v_out_dma_buf[0], whole_line);
+
+  if (fit_mode)
+  { // scaled image starts with the whole captured frame, zoom mode narrows it down in update_vga_scaler()
+    scaler_window_t win = {0, 0, h_visible_area * 2, V_BUF_H};
+
+    for (int i = 0; i < 2; i++)
+    {
+      scalers[i].col_map = (uint16_t *)arena;
+      arena += (video_mode.h_visible_area / unit + 1) / 2;
+    }
+
+    scaler_setup(&scalers[0], &win, h_visible_area);
+    scaler = &scalers[0];
+    scaler_next = NULL;
+  }
+
+  out_y = video_mode.v_visible_area;
 
   // PIO initialization
   pio_sm_config c = pio_get_default_sm_config();
@@ -370,7 +1173,7 @@ void start_vga()
   sm_config_set_out_shift(&c, true, true, 32);
   sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
 
-  sm_config_set_clkdiv(&c, ((float)clock_get_hz(clk_sys) * video_mode.div) / video_mode.pixel_freq);
+  sm_config_set_clkdiv(&c, ((float)clock_get_hz(clk_sys) * unit) / video_mode.pixel_freq);
 
   pio_sm_init(PIO_VGA, SM_VGA, offset, &c);
   pio_sm_set_enabled(PIO_VGA, SM_VGA, true);
@@ -421,6 +1224,14 @@ void start_vga()
   irq_set_enabled(DMA_IRQ_0, true);
 
   dma_start_channel_mask((1u << dma_ch0));
+
+  // the state machine stalled before the first line arrived, that is not an underrun
+  PIO_VGA->fdebug = 1u << (PIO_FDEBUG_TXSTALL_LSB + SM_VGA);
+}
+
+bool __not_in_flash_func(vga_dma_busy)()
+{
+  return dma_channel_is_busy(dma_ch0) || dma_channel_is_busy(dma_ch1);
 }
 
 void stop_vga()
@@ -442,28 +1253,15 @@ void stop_vga()
   dma_channel_unclaim(dma_ch0);
   dma_channel_unclaim(dma_ch1);
 
-  // free individual buffer allocations
-  if (v_out_dma_buf[0] != NULL)
-  {
-    free(v_out_dma_buf[0]);
-    v_out_dma_buf[0] = NULL;
-  }
+  // the buffers stay in the static arena for the next start
+  for (int i = 0; i < 5; i++)
+    v_out_dma_buf[i] = NULL;
 
-  if (v_out_dma_buf[1] != NULL)
-  {
-    free(v_out_dma_buf[1]);
-    v_out_dma_buf[1] = NULL;
-  }
-
-  if (v_out_dma_buf[2] != NULL)
-  {
-    free(v_out_dma_buf[2]);
-    v_out_dma_buf[2] = NULL;
-  }
+  for (int i = 0; i < 2; i++)
+    scalers[i].col_map = NULL;
 
-  if (v_out_dma_buf[3] != NULL)
-  {
-    free(v_out_dma_buf[3]);
-    v_out_dma_buf[3] = NULL;
-  }
+  fit_mode = false;
+  scale2x_mode = false;
+  blend_mode = false;
+  set_v_buf_keep_prev(false);
 }
\ No newline at end of file
@@ -1,5 +1,12 @@
 #pragma once
 
-void set_vga_scanlines_mode(bool);
+uint8_t get_vga_unit(video_mode_t *, scaling_mode_t);
+uint32_t get_vga_sys_freq(video_mode_t *, scaling_mode_t);
+uint32_t get_vga_render_cycles();
+uint32_t get_vga_osd_render_cycles();
+uint32_t get_vga_render_budget(video_mode_t *, scaling_mode_t);
+void set_vga_scanlines_mode(bool, bool);
 void start_vga();
-void stop_vga();
\ No newline at end of file
+bool vga_dma_busy();
+void stop_vga();
+void update_vga_scaler();
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "hardware/gpio.h"
+#include "hardware/timer.h"
 
 #include "g_config.h"
 #include "video_output.h"
@@ -18,6 +19,19 @@ int16_t h_visible_area;
 int16_t h_margin;
 int16_t v_visible_area;
 int16_t v_margin;
+int16_t v_display_lines;
+
+// blank time of the last output switch: from stop_video_output() to the first whole frame of the new output
+static uint32_t switch_start = 0;
+static volatile bool switch_pending = false;
+static volatile bool output_switching = false; // from the start of stop_video_output() to the end of start_video_output()
+static volatile uint32_t switch_time = 0;
+
+// statistics: output frames and SysTick cycles spent in the output ISR (core 0)
+volatile uint32_t out_frame_count = 0;
+volatile uint32_t out_isr_cycles = 0;
+
+static void build_no_signal(video_mode_t);
 
 video_out_type_t detect_video_output_type()
 {
@@ -75,6 +89,17 @@ void set_video_mode_params(video_mode_t v_mode)
 {
   video_mode = v_mode;
 
+  if (active_video_output == VGA && (settings.scaling_mode == SCALE_FIT || settings.scaling_mode == SCALE_ZOOM))
+  { // fractional scaler: whole captured line and all V_BUF_H lines, the scaled geometry is set up by the VGA driver
+    h_visible_area = (uint8_t)(settings.frequency / 1000000) * (ACTIVE_VIDEO_TIME / 2);
+    h_margin = 0;
+    v_visible_area = video_mode.v_visible_area;
+    v_margin = 0;
+    v_display_lines = V_BUF_H;
+
+    return;
+  }
+
   h_visible_area = (uint16_t)(video_mode.h_visible_area / (video_mode.div * 4)) * 2;
   h_margin = (h_visible_area - (uint8_t)(settings.frequency / 1000000) * (ACTIVE_VIDEO_TIME / 2)) / 2;
 
@@ -88,6 +113,8 @@ void set_video_mode_params(video_mode_t v_mode)
 
   if (v_margin < 0)
     v_margin = 0;
+
+  v_display_lines = (video_mode.v_visible_area - 2 * v_margin) / video_mode.div;
 }
 
 void start_video_output(video_out_type_t output_type)
@@ -95,6 +122,7 @@ void start_video_output(video_out_type_t output_type)
   active_video_output = output_type;
 
   set_video_mode_params(*(video_modes[settings.video_out_mode]));
+  build_no_signal(video_mode);
 
 #ifdef OSD_ENABLE
   osd_set_position();
@@ -113,10 +141,44 @@ void start_video_output(video_out_type_t output_type)
   default:
     break;
   }
+
+  output_switching = false;
+}
+
+// called by the output drivers at the start of every frame
+void __not_in_flash_func(mark_video_output_frame)()
+{
+  out_frame_count++;
+
+  if (switch_pending)
+  {
+    switch_time = time_us_32() - switch_start;
+    switch_pending = false;
+  }
+}
+
+// microseconds, 0 until the new output has started its first frame
+uint32_t get_video_output_switch_time()
+{
+  return switch_pending ? 0 : switch_time;
+}
+
+bool __not_in_flash_func(is_video_output_switching)()
+{
+  return output_switching;
+}
+
+void update_video_output()
+{
+  if (active_video_output == VGA)
+    update_vga_scaler();
 }
 
 void stop_video_output()
 {
+  output_switching = true;
+  switch_start = time_us_32();
+
   switch (active_video_output)
   {
   case DVI:
@@ -130,12 +192,15 @@ void stop_video_output()
   default:
     break;
   }
+
+  // the output interrupt is off now, the next frame start is the new output's
+  switch_pending = true;
 }
 
 void set_scanlines_mode()
 {
   if (settings.video_out_type == VGA)
-    set_vga_scanlines_mode(settings.scanlines_mode);
+    set_vga_scanlines_mode(settings.scanlines_mode, settings.scanlines_dim);
 }
 
 void draw_welcome_screen(video_mode_t video_mode)
@@ -150,20 +215,23 @@ void draw_welcome_screen(video_mode_t video_mode)
 
   uint8_t *v_buf = (uint8_t *)get_v_buf_out();
 
-  for (int y = 0; y < V_BUF_H; y++)
-    for (int x = 0; x < V_BUF_W; x++)
-    {
-      uint8_t i = 0x0f & ~(uint8_t)((16 * x) / h_visible_area);
-      uint8_t R = (i & 4) ? ((i & 1) ? 0b0100 : 0b1100) : 0;
-      uint8_t G = (i & 8) ? ((i & 1) ? 0b0010 : 0b1010) : 0;
-      uint8_t B = (i & 2) ? ((i & 1) ? 0b0001 : 0b1001) : 0;
-      uint8_t c = R | G | B;
-
-      if (x & 1)
-        *v_buf++ |= c << 4;
-      else
-        *v_buf = c & 0x0f;
-    }
+  // vertical stripes: the first line is drawn, the others are copies of it
+  for (int x = 0; x < V_BUF_W; x++)
+  {
+    uint8_t i = 0x0f & ~(uint8_t)((16 * x) / h_visible_area);
+    uint8_t R = (i & 4) ? ((i & 1) ? 0b0100 : 0b1100) : 0;
+    uint8_t G = (i & 8) ? ((i & 1) ? 0b0010 : 0b1010) : 0;
+    uint8_t B = (i & 2) ? ((i & 1) ? 0b0001 : 0b1001) : 0;
+    uint8_t c = R | G | B;
+
+    if (x & 1)
+      v_buf[x / 2] |= c << 4;
+    else
+      v_buf[x / 2] = c & 0x0f;
+  }
+
+  for (int y = 1; y < V_BUF_H; y++)
+    memcpy(&v_buf[y * (V_BUF_W / 2)], v_buf, V_BUF_W / 2);
 }
 
 void draw_welcome_screen_h(video_mode_t video_mode)
@@ -210,7 +278,12 @@ const char nosignal[14][115] = {
     "xx      xx      xxxxxx                  xxxxxx      xxxxxx      xxxxxx      xx      xx    xx      xx    xxxxxxxxxx",
 };
 
-void draw_no_signal(video_mode_t video_mode)
+// NO SIGNAL text rows for the current mode after a black row, the output ISR reads them while there is no signal
+// built only while the output is stopped, so the ISR never sees a half-built row
+static uint8_t no_signal_rows[1 + 14][V_BUF_W / 2];
+static uint16_t no_signal_y = 0;
+
+static void build_no_signal(video_mode_t video_mode)
 {
   uint8_t c;
   uint8_t c2;
@@ -226,12 +299,11 @@ void draw_no_signal(video_mode_t video_mode)
   if (v_margin < 0)
     v_margin = 0;
 
-  uint16_t y = (video_mode.v_visible_area - v_margin) / (video_mode.div * 2);
   uint16_t x = (h_visible_area - h_margin - 114) / 4;
 
-  uint8_t *v_buf = (uint8_t *)get_v_buf_out();
+  no_signal_y = (video_mode.v_visible_area - v_margin) / (video_mode.div * 2);
 
-  memset(v_buf, 0, V_BUF_H * V_BUF_W / 2);
+  memset(no_signal_rows, 0, sizeof(no_signal_rows));
 
   for (int row = 0; row < 14; ++row)
     for (int col = 0; col < 114; ++col)
@@ -239,8 +311,25 @@ void draw_no_signal(video_mode_t video_mode)
       c = (nosignal[row][col] == 'x') ? 0b0111 : 0b0000;
 
       if (col & 1)
-        v_buf[(y + row) * V_BUF_W / 2 + x + col / 2] = c2 | (c << 4);
+        no_signal_rows[1 + row][x + col / 2] = c2 | (c << 4);
       else
         c2 = c;
     }
+}
+
+// source line y of the NO SIGNAL screen: the text rows, black elsewhere
+uint8_t *__not_in_flash_func(get_no_signal_line)(int16_t y)
+{
+  uint16_t row = y - no_signal_y;
+
+  return no_signal_rows[row < 14 ? 1 + row : 0];
+}
+
+// NO SIGNAL screen of the running output mode drawn into the shown buffer
+void draw_no_signal()
+{
+  uint8_t *v_buf = (uint8_t *)get_v_buf_out();
+
+  memset(v_buf, 0, V_BUF_SZ);
+  memcpy(&v_buf[no_signal_y * (V_BUF_W / 2)], no_signal_rows[1], 14 * (V_BUF_W / 2));
 }
\ No newline at end of file
@@ -1,9 +1,17 @@
 #pragma once
 
+extern volatile uint32_t out_frame_count;
+extern volatile uint32_t out_isr_cycles;
+
 video_out_type_t detect_video_output_type();
 void start_video_output(video_out_type_t);
+void update_video_output();
+void mark_video_output_frame();
+uint32_t get_video_output_switch_time();
+bool is_video_output_switching();
 void stop_video_output();
 void set_scanlines_mode();
 void draw_welcome_screen(video_mode_t);
 void draw_welcome_screen_h(video_mode_t);
-void draw_no_signal(video_mode_t);
\ No newline at end of file
+void draw_no_signal();
+uint8_t *get_no_signal_line(int16_t);
\ No newline at end of file
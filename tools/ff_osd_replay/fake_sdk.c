@@ -0,0 +1,90 @@
+// fake Pico SDK for the replay tool: GPIO / IRQ setup does nothing, the I2C slave is a byte pump
+// a transaction calls the registered handler once per byte and once at the Stop, like the SDK IRQ
+#include <stddef.h>
+
+#include "pico/stdlib.h"
+#include "pico/i2c_slave.h"
+
+static i2c_hw_t i2c0_hw;
+i2c_inst_t i2c0_inst = {&i2c0_hw, false};
+
+static i2c_slave_handler_t handler;
+static uint8_t rx_byte;   // byte returned by the next i2c_read_byte_raw()
+static uint8_t *tx_bytes; // where i2c_write_byte_raw() stores
+static uint16_t tx_len;
+
+void gpio_init(uint gpio)
+{
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn)
+{
+}
+
+void gpio_pull_up(uint gpio)
+{
+}
+
+void irq_set_priority(uint num, uint8_t hardware_priority)
+{
+}
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate)
+{
+    return baudrate;
+}
+
+uint i2c_hw_index(i2c_inst_t *i2c)
+{
+    return 0;
+}
+
+uint8_t i2c_read_byte_raw(i2c_inst_t *i2c)
+{
+    return rx_byte;
+}
+
+void i2c_write_byte_raw(i2c_inst_t *i2c, uint8_t value)
+{
+    if (tx_bytes != NULL)
+        tx_bytes[tx_len++] = value;
+}
+
+void i2c_slave_init(i2c_inst_t *i2c, uint8_t address, i2c_slave_handler_t slave_handler)
+{
+    i2c->hw->sar = address;
+    handler = slave_handler;
+}
+
+void i2c_slave_deinit(i2c_inst_t *i2c)
+{
+    handler = NULL;
+}
+
+void fake_i2c_write(const uint8_t *data, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++)
+    {
+        rx_byte = data[i];
+        handler(i2c0, I2C_SLAVE_RECEIVE);
+    }
+
+    handler(i2c0, I2C_SLAVE_FINISH);
+}
+
+void fake_i2c_read(uint8_t *data, uint16_t len)
+{
+    tx_bytes = data;
+    tx_len = 0;
+
+    for (uint16_t i = 0; i < len; i++)
+        handler(i2c0, I2C_SLAVE_REQUEST);
+
+    handler(i2c0, I2C_SLAVE_FINISH);
+    tx_bytes = NULL;
+}
+
+uint8_t fake_i2c_address()
+{
+    return i2c0->hw->sar;
+}
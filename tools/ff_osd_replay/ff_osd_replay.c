@@ -0,0 +1,552 @@
+// replay of recorded I2C traffic through the FF OSD I2C slave and parsers (src/ff_osd_i2c.c) on the host
+// the receive handler and the parsers are the firmware code, only the SDK below them is fake (fake_sdk.c)
+//
+// cc -O2 -DBOARD_36LJU22 -DOSD_FF_ENABLE -I tools/host_sdk -I src -o ff_osd_replay tools/ff_osd_replay/*.c src/ff_osd_i2c.c
+// ./ff_osd_replay tools/ff_osd_replay/traces/*.trace    replay, check, exit code 1 on any failure
+// ./ff_osd_replay --bench [host MHz]                     cycles per byte of the slave handler and the parsers
+// ./ff_osd_replay --fuzz [rounds [seed]]                  random transactions through the slave handler, exit code 1 on any failure
+//
+// build the fuzzer with -fsanitize=address,undefined as well: a text write outside the display is then reported
+//
+// trace format, one item per line, # starts a comment:
+//   protocol ff                  FlashFloppy protocol (address 0x10)
+//   protocol lcd <cols> <rows>   HD44780 behind a PCF8574 (address 0x27), ROWS / COLUMNS of the menu
+//   w <bytes>                    write transaction: hex bytes and "text", parsed at once as on core 1
+//   r <bytes>                    read transaction, the slave must answer these bytes
+//   hold / process               queue the following writes, parse them all in one go
+//   expect <item> <n>            on, cols, rows, heights, buttons, address, transactions, overflows
+//   expect row <n> "<text>"      start of a text row
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pico/i2c_slave.h"
+
+#include "g_config.h"
+#include "ff_osd.h"
+
+#define TRACE_BYTES_MAX 1024
+#define FUZZ_BYTES_MAX 1100 // a bit more than the data ring
+
+// RP2040 estimate of --bench: the Cortex-M0+ issues one instruction per cycle at most and a load
+// takes 2, a current desktop core retires 3-4 per cycle, so assume 4 M0+ cycles per host cycle
+// not included: interrupt entry and exit, about 30 cycles per byte on the M0+
+#define M0_CYCLES_PER_HOST_CYCLE 4
+#define M0_MHZ 184.5 // lowest sys_freq in g_config.c
+
+// PCF8574 pin assignment: D7-D6-D5-D4-BL-EN-RW-RS
+#define _BL (1u << 3)
+#define _EN (1u << 2)
+#define _RS (1u << 0)
+
+settings_t settings;
+extern ff_osd_info_t ff_osd_info; // src/ff_osd_i2c.c, the reply to a read
+
+static const char *trace_name;
+static int trace_line;
+static int failures;
+static bool hold;
+
+static void fail(const char *fmt, const char *arg)
+{
+    fprintf(stderr, "%s:%d: ", trace_name, trace_line);
+    fprintf(stderr, fmt, arg);
+    fputc('\n', stderr);
+    failures++;
+}
+
+static void process()
+{
+    if (ff_osd_i2c_pending())
+        ff_osd_i2c_process();
+}
+
+static void set_protocol(bool ff, uint16_t cols, uint16_t rows)
+{
+    settings.ff_osd_config.i2c_protocol = ff;
+    settings.ff_osd_config.cols = cols;
+    settings.ff_osd_config.rows = rows;
+    ff_osd_i2c_init();
+
+    ff_osd_i2c_transactions = 0;
+    ff_osd_i2c_overflows = 0;
+}
+
+// hex bytes and "quoted text" -> bytes, -1 on a syntax error
+static int parse_bytes(char *s, uint8_t *out)
+{
+    int n = 0;
+
+    while (*s)
+    {
+        if (*s == ' ' || *s == '\t')
+        {
+            s++;
+            continue;
+        }
+
+        if (*s == '"')
+        {
+            char *end = strchr(++s, '"');
+
+            if (end == NULL || n + (end - s) > TRACE_BYTES_MAX)
+                return -1;
+
+            memcpy(&out[n], s, end - s);
+            n += end - s;
+            s = end + 1;
+            continue;
+        }
+
+        char *end;
+        unsigned long x = strtoul(s, &end, 16);
+
+        if (end == s || x > 0xff || n == TRACE_BYTES_MAX)
+            return -1;
+
+        out[n++] = x;
+        s = end;
+    }
+
+    return n;
+}
+
+static void expect_row(char *s)
+{
+    char *end;
+    long y = strtol(s, &end, 0);
+    char *text = strchr(end, '"');
+    char *text_end = text != NULL ? strchr(text + 1, '"') : NULL;
+
+    if (end == s || y < 0 || y >= 4 || text_end == NULL || text_end - text - 1 > 40)
+    {
+        fail("bad expect row: %s", s);
+        return;
+    }
+
+    text++;
+    *text_end = '\0';
+
+    if (memcmp(ff_osd_display.text[y], text, text_end - text))
+    {
+        char shown[41];
+
+        memcpy(shown, ff_osd_display.text[y], 40);
+        shown[text_end - text] = '\0';
+        fail("row shows \"%s\"", shown);
+    }
+}
+
+static void expect(char *s)
+{
+    static const char *names[] = {"on", "cols", "rows", "heights", "buttons", "address", "transactions", "overflows"};
+    char name[16];
+    long value;
+
+    if (!strncmp(s, "row ", 4))
+    {
+        expect_row(s + 4);
+        return;
+    }
+
+    if (sscanf(s, "%15s %li", name, &value) != 2)
+    {
+        fail("bad expect: %s", s);
+        return;
+    }
+
+    long actual[] = {
+        ff_osd_display.on,
+        ff_osd_display.cols,
+        ff_osd_display.rows,
+        ff_osd_display.heights,
+        ff_osd_buttons_rx,
+        fake_i2c_address(),
+        ff_osd_i2c_transactions,
+        ff_osd_i2c_overflows,
+    };
+
+    for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (strcmp(name, names[i]))
+            continue;
+
+        if (actual[i] != value)
+        {
+            char msg[80];
+
+            snprintf(msg, sizeof(msg), "%s %ld, expected %ld", name, actual[i], value);
+            fail("%s", msg);
+        }
+
+        return;
+    }
+
+    fail("unknown expect: %s", name);
+}
+
+static void replay(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[4096];
+    uint8_t bytes[TRACE_BYTES_MAX], reply[TRACE_BYTES_MAX];
+    int failed = failures;
+
+    trace_name = path;
+    trace_line = 0;
+    hold = false;
+
+    if (f == NULL)
+    {
+        fail("%s", "cannot open");
+        return;
+    }
+
+    while (fgets(line, sizeof(line), f))
+    {
+        char *s = line;
+        int n;
+
+        trace_line++;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        while (*s == ' ' || *s == '\t')
+            s++;
+
+        if (*s == '\0' || *s == '#')
+            continue;
+
+        if (!strncmp(s, "w ", 2))
+        {
+            if ((n = parse_bytes(s + 2, bytes)) < 0)
+                fail("bad bytes: %s", s);
+            else
+            {
+                fake_i2c_write(bytes, n);
+
+                if (!hold)
+                    process();
+            }
+        }
+        else if (!strncmp(s, "r ", 2))
+        {
+            if ((n = parse_bytes(s + 2, bytes)) < 0)
+                fail("bad bytes: %s", s);
+            else
+            {
+                fake_i2c_read(reply, n);
+
+                if (memcmp(reply, bytes, n))
+                    fail("%s", "read returned other bytes");
+            }
+        }
+        else if (!strcmp(s, "hold"))
+            hold = true;
+        else if (!strcmp(s, "process"))
+        {
+            hold = false;
+            process();
+        }
+        else if (!strncmp(s, "expect ", 7))
+            expect(s + 7);
+        else if (!strcmp(s, "protocol ff"))
+            set_protocol(true, 0, 0);
+        else
+        {
+            unsigned cols, rows;
+
+            if (sscanf(s, "protocol lcd %u %u", &cols, &rows) == 2)
+                set_protocol(false, cols, rows);
+            else
+                fail("unknown line: %s", s);
+        }
+    }
+
+    fclose(f);
+    printf("%s %s\n", failures == failed ? "PASS" : "FAIL", path);
+}
+
+// one refresh as FlashFloppy sends it: 40x3, backlight on, row 0 double height
+static uint16_t bench_ff(uint8_t *t)
+{
+    uint16_t n = 0;
+
+    t[n++] = 0x40 | 40;
+    t[n++] = 0x10 | 3;
+    t[n++] = 0x20 | 1;
+    t[n++] = 0x30;
+    t[n++] = 0x01;
+    t[n++] = 0x02;
+
+    for (int i = 0; i < 40 * 3; i++)
+        t[n++] = 'A' + i % 26;
+
+    return n;
+}
+
+static uint16_t lcd_nibbles(uint8_t *t, uint8_t x, bool rs)
+{
+    uint8_t hi = (x & 0xf0) | _BL | (rs ? _RS : 0);
+    uint8_t lo = (x << 4) | _BL | (rs ? _RS : 0);
+
+    // data latched on the falling edge of EN
+    t[0] = hi | _EN;
+    t[1] = hi;
+    t[2] = lo | _EN;
+    t[3] = lo;
+
+    return 4;
+}
+
+// a 20x4 LCD refresh: per row Set DDR Address and 20 characters, 4 bus bytes per LCD byte
+static uint16_t bench_lcd(uint8_t *t)
+{
+    static const uint8_t row_addr[] = {0x00, 0x40, 0x14, 0x54};
+    uint16_t n = 0;
+
+    for (int y = 0; y < 4; y++)
+    {
+        n += lcd_nibbles(&t[n], 0x80 | row_addr[y], false);
+
+        for (int x = 0; x < 20; x++)
+            n += lcd_nibbles(&t[n], 'a' + (x + y) % 26, true);
+    }
+
+    return n;
+}
+
+static double now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// clock of the first CPU in /proc/cpuinfo, 0 if unknown
+static double host_mhz()
+{
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    char line[256];
+    double mhz = 0;
+
+    if (f == NULL)
+        return 0;
+
+    while (fgets(line, sizeof(line), f))
+        if (sscanf(line, "cpu MHz : %lf", &mhz) == 1)
+            break;
+
+    fclose(f);
+    return mhz;
+}
+
+static void bench(const char *name, bool ff, uint16_t (*build)(uint8_t *), double mhz)
+{
+    uint8_t t[TRACE_BYTES_MAX];
+    uint16_t len = build(t);
+    uint32_t transactions = 0;
+    double start, elapsed;
+
+    set_protocol(ff, 20, 4);
+    start = now();
+
+    do
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            fake_i2c_write(t, len);
+            process();
+        }
+
+        transactions += 1000;
+        elapsed = now() - start;
+    } while (elapsed < 1.0);
+
+    double ns = elapsed * 1e9 / ((double)transactions * len);
+    double cycles = ns * mhz * 1e-3;
+    double m0_us = cycles * M0_CYCLES_PER_HOST_CYCLE / M0_MHZ;
+
+    // 100 kHz bus: 9 clocks per byte (8 bits and the ACK), start / address / stop not counted
+    printf("%-12s %4u bytes/transaction  %5.1f ns = %5.1f host cycles/byte  RP2040 ~%4.0f cycles = %5.2f us/byte, "
+           "%4.1f%% of a 100 kHz byte  %u overflows\n",
+           name, len, ns, cycles, cycles * M0_CYCLES_PER_HOST_CYCLE, m0_us, m0_us / 90 * 100, ff_osd_i2c_overflows);
+}
+
+// a refresh after any garbage must show exactly: the parsers do not get stuck
+static void fuzz_recover(bool ff)
+{
+    uint8_t t[TRACE_BYTES_MAX];
+    uint16_t len;
+
+    if (ff)
+        len = bench_ff(t);
+    else
+    {
+        // a data nibble first: the nibble pairing restarts at the first command of the refresh
+        t[0] = _BL | _EN | _RS;
+        t[1] = _BL | _RS;
+        len = 2 + bench_lcd(&t[2]);
+    }
+
+    fake_i2c_write(t, len);
+    process();
+
+    for (int y = 0; y < (ff ? 3 : 4); y++)
+        for (int x = 0; x < (ff ? 40 : 20); x++)
+        {
+            // LCD rows 2 and 3 continue rows 0 and 1 unless the display has 4 rows
+            bool four = ff || ff_osd_display.rows == 4;
+            char c = ff_osd_display.text[four ? y : y & 1][four ? x : x + (y >> 1) * 20];
+
+            if (c != (ff ? 'A' + (y * 40 + x) % 26 : 'a' + (x + y) % 26))
+            {
+                fail("%s", "refresh after garbage not shown");
+                return;
+            }
+        }
+
+    if (!ff_osd_display.on || (ff && (ff_osd_display.cols != 40 || ff_osd_display.rows != 3 || ff_osd_display.heights != 1)))
+        fail("%s", "refresh after garbage: wrong layout");
+}
+
+// random writes, reads and bare Stops in both protocols, checked against a model of the rings:
+// a write is dropped exactly when the transaction ring is full or its bytes do not fit the data ring
+static void fuzz(long rounds, unsigned seed)
+{
+    static uint8_t bytes[FUZZ_BYTES_MAX], reply[FUZZ_BYTES_MAX];
+    const uint8_t *info = (const uint8_t *)&ff_osd_info;
+    char msg[80];
+    long writes = 0, dropped = 0;
+
+    srand(seed);
+    trace_name = "fuzz";
+
+    for (trace_line = 1; trace_line <= rounds && failures < 20; trace_line++)
+    {
+        bool ff = rand() & 1;
+        uint16_t queued_t = 0, queued_d = 0; // written since the last process()
+
+        set_protocol(ff, 16 + rand() % 25, FF_OSD_ROWS_MIN + rand() % (FF_OSD_ROWS_MAX - FF_OSD_ROWS_MIN + 1));
+        ff_osd_set_buttons(rand() & 0x0f);
+        process(); // the rings are not reset by ff_osd_i2c_init()
+
+        for (int n = 1 + rand() % 20; n > 0; n--)
+        {
+            uint32_t bytes_before = ff_osd_i2c_bytes;
+            uint32_t transactions = ff_osd_i2c_transactions;
+            uint32_t overflows = ff_osd_i2c_overflows;
+            uint32_t phantoms = ff_osd_i2c_phantoms;
+            int kind = rand() % 8;
+            uint16_t len = kind == 0 ? 0 : rand() % 16 ? rand() % 64 : rand() % FUZZ_BYTES_MAX;
+
+            if (kind == 1)
+            {
+                // read: the info block, then zeros
+                fake_i2c_read(reply, len);
+
+                for (uint16_t i = 0; i < len; i++)
+                    if (reply[i] != (i < sizeof(ff_osd_info_t) ? info[i] : 0))
+                        fail("%s", "read returned other bytes");
+            }
+            else
+            {
+                // write, a bare Stop for len 0
+                bool drop = queued_t >= 8 || queued_d + len > 1024; // t_ring and d_ring sizes
+
+                for (uint16_t i = 0; i < len; i++)
+                    bytes[i] = rand();
+
+                fake_i2c_write(bytes, len);
+
+                if (len == 0)
+                    drop = false;
+                else if (!drop)
+                {
+                    queued_t++;
+                    queued_d += len;
+                }
+
+                writes += len != 0;
+                dropped += len != 0 && drop;
+
+                if (ff_osd_i2c_transactions - transactions != (len != 0 && !drop) ||
+                    ff_osd_i2c_overflows - overflows != (len != 0 && drop) ||
+                    ff_osd_i2c_phantoms - phantoms != (len == 0))
+                {
+                    snprintf(msg, sizeof(msg), "%u byte write after %u queued (%u bytes): counted wrong",
+                             len, queued_t, queued_d);
+                    fail("%s", msg);
+                }
+            }
+
+            if (ff_osd_i2c_bytes - bytes_before != len)
+                fail("%s", "byte count");
+
+            if (rand() % 3 == 0)
+            {
+                process();
+                queued_t = queued_d = 0;
+
+                if (ff_osd_i2c_pending())
+                    fail("%s", "transactions left after process");
+            }
+
+            if (ff_osd_display.cols > FF_OSD_COLUMNS_MAX || ff_osd_display.rows > FF_OSD_ROWS_MAX ||
+                ff_osd_display.heights > 0x0f)
+            {
+                snprintf(msg, sizeof(msg), "layout %ux%u heights %x", ff_osd_display.cols, ff_osd_display.rows,
+                         ff_osd_display.heights);
+                fail("%s", msg);
+            }
+
+            if (!ff && ff_osd_display.rows != settings.ff_osd_config.rows)
+                fail("%s", "LCD rows changed");
+        }
+
+        process();
+        fuzz_recover(ff);
+    }
+
+    printf("%s fuzz: %ld rounds, seed %u, %ld writes, %ld dropped\n", failures ? "FAIL" : "PASS", trace_line - 1L,
+           seed, writes, dropped);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s trace... | --bench [host MHz] | --fuzz [rounds [seed]]\n", argv[0]);
+        return 2;
+    }
+
+    if (!strcmp(argv[1], "--fuzz"))
+    {
+        fuzz(argc > 2 ? atol(argv[2]) : 100000, argc > 3 ? atoi(argv[3]) : 1);
+        return failures != 0;
+    }
+
+    if (!strcmp(argv[1], "--bench"))
+    {
+        // cpuinfo may give the base clock, pass the clock the core really runs at under load if it boosts
+        double mhz = argc > 2 ? atof(argv[2]) : host_mhz();
+
+        if (mhz <= 0)
+        {
+            fprintf(stderr, "host clock unknown, give it in MHz: %s --bench <MHz>\n", argv[0]);
+            return 2;
+        }
+
+        printf("host at %.0f MHz, RP2040 assumed at %d cycles per host cycle and %.1f MHz\n", mhz,
+               M0_CYCLES_PER_HOST_CYCLE, M0_MHZ);
+        bench("FlashFloppy", true, bench_ff, mhz);
+        bench("HD44780", false, bench_lcd, mhz);
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++)
+        replay(argv[i]);
+
+    return failures != 0;
+}
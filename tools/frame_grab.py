@@ -0,0 +1,241 @@
+#!/usr/bin/env python3
+"""
+Frame grabber host tool for the scan converter.
+
+Pulls one captured frame over the USB serial port and writes it as a PNG. On
+a serial device the tool opens the configuration menu and sends the grab
+command itself (T, then f); any menu text around the binary data is skipped.
+The stream format is described in src/frame_grab.h: an 8-byte header, one
+RLE-compressed record per line and a trailer with the CRC-32 of the frame.
+
+With triple buffering the displayed frame is pinned for the transfer (the
+picture holds still for a moment), otherwise one line is copied per captured
+frame, which takes about six seconds at 50 Hz.
+
+Examples:
+  frame_grab.py /dev/ttyACM0 -o frame.png
+  frame_grab.py /dev/ttyACM0 -o frame.png --save grab.bin   # keep the raw stream
+  frame_grab.py grab.bin -o frame.png                       # decode a saved stream
+  frame_grab.py tools/grab_sample.bin -o frame.png
+
+tools/grab_sample.bin is written by the firmware encoder built on the host
+(tools/usb_record).
+
+Only the standard library is needed.
+"""
+
+import argparse
+import os
+import stat
+import struct
+import sys
+import time
+import zlib
+
+# must match src/frame_grab.h
+MAGIC = b"ZG"
+VERSION = 1
+HEADER = "<2sBBHH"
+RECORD = "<HH"
+LINE_END = 0xFFFF
+MODES = ("frame", "lines")
+
+# RGBI: bit 3 bright, bit 2 red, bit 1 green, bit 0 blue (as the output palettes)
+PALETTE = [
+    tuple(((255 if c & 8 else 170) if c & bit else 0) for bit in (4, 2, 1))
+    for c in range(16)
+]
+
+
+def rle_decode(data, size):
+    out = bytearray()
+    i = 0
+
+    while i < len(data):
+        c = data[i]
+        i += 1
+
+        if c < 0x80:
+            out += data[i:i + c + 1]
+            i += c + 1
+        else:
+            out += bytes([data[i]]) * ((c & 0x7F) + 3)
+            i += 1
+
+    if len(out) != size:
+        raise ValueError("line decodes to %d bytes, expected %d" % (len(out), size))
+
+    return bytes(out)
+
+
+class Reader:
+    """Byte reader over a chunk iterator, with resynchronisation on a magic."""
+
+    def __init__(self, chunks):
+        self.chunks = chunks
+        self.buf = b""
+        self.skipped = 0
+
+    def fill(self, n):
+        while len(self.buf) < n:
+            chunk = next(self.chunks, None)
+
+            if chunk is None:
+                raise EOFError("stream ended")
+
+            self.buf += chunk
+
+    def peek(self, n):
+        self.fill(n)
+        return self.buf[:n]
+
+    def read(self, n):
+        self.fill(n)
+        data, self.buf = self.buf[:n], self.buf[n:]
+        return data
+
+    def sync(self, magic, size):
+        """Skip up to the next magic, return the `size` bytes starting with it."""
+        while True:
+            i = self.buf.find(magic)
+
+            if i >= 0:
+                self.skipped += i
+                self.buf = self.buf[i:]
+                return self.read(size)
+
+            keep = len(magic) - 1
+            self.skipped += max(len(self.buf) - keep, 0)
+            self.buf = self.buf[-keep:] if keep else b""
+            self.fill(len(self.buf) + 1)
+
+
+def read_frame(reader):
+    """Read one grab: returns (mode, width, height, list of line bytes)."""
+    while True:
+        magic, version, mode, width, height = struct.unpack(HEADER, reader.sync(MAGIC, struct.calcsize(HEADER)))
+
+        if version == VERSION and mode < len(MODES) and 0 < width <= 4096 and 0 < height <= 4096:
+            break
+
+    line_bytes = width // 2
+    lines = [None] * height
+    crc = 0
+
+    while True:
+        y, length = struct.unpack(RECORD, reader.read(struct.calcsize(RECORD)))
+        data = reader.read(length)
+
+        if y == LINE_END:
+            (sent_crc,) = struct.unpack("<I", data)
+            break
+
+        if y >= height:
+            raise ValueError("line %d out of range" % y)
+
+        lines[y] = rle_decode(data, line_bytes)
+        crc = zlib.crc32(lines[y], crc)
+
+    if None in lines:
+        raise ValueError("%d lines missing" % lines.count(None))
+
+    if crc != sent_crc:
+        raise ValueError("CRC mismatch: %08x received, %08x computed" % (sent_crc, crc))
+
+    return MODES[mode], width, height, lines
+
+
+def unpack_pixels(line):
+    """4bpp, low nibble first -> list of colour indices."""
+    px = []
+
+    for b in line:
+        px.append(b & 0x0F)
+        px.append(b >> 4)
+
+    return px
+
+
+def write_png(path, width, height, rows, palette=PALETTE):
+    """8-bit indexed PNG; rows are lists of colour indices."""
+    def chunk(kind, data):
+        return struct.pack(">I", len(data)) + kind + data + struct.pack(">I", zlib.crc32(kind + data))
+
+    raw = b"".join(b"\x00" + bytes(r) for r in rows)
+
+    with open(path, "wb") as f:
+        f.write(b"\x89PNG\r\n\x1a\n")
+        f.write(chunk(b"IHDR", struct.pack(">IIBBBBB", width, height, 8, 3, 0, 0, 0)))
+        f.write(chunk(b"PLTE", b"".join(bytes(c) for c in palette)))
+        f.write(chunk(b"IDAT", zlib.compress(raw, 9)))
+        f.write(chunk(b"IEND", b""))
+
+
+def open_source(path, trigger, keys):
+    """Chunk iterator over a file or a serial device; on a device the command keys are sent first."""
+    device = stat.S_ISCHR(os.stat(path).st_mode)
+    fd = os.open(path, os.O_RDWR if device and trigger else os.O_RDONLY)
+
+    if os.isatty(fd):
+        import termios
+        import tty
+
+        tty.setraw(fd)
+        termios.tcflush(fd, termios.TCIFLUSH)
+
+        if trigger:
+            # the first key opens the menu (or is ignored inside it), then the test menu and the command
+            for k in (b"\r",) + tuple(bytes([c]) for c in keys):
+                os.write(fd, k)
+                time.sleep(0.2)
+
+    def chunks():
+        try:
+            while True:
+                chunk = os.read(fd, 4096)
+
+                if not chunk:
+                    return
+
+                yield chunk
+        finally:
+            os.close(fd)
+
+    return chunks()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="scan converter frame grabber")
+    parser.add_argument("source", help="serial device (/dev/ttyACM0) or a saved stream")
+    parser.add_argument("-o", "--output", default="frame.png", help="PNG file (default: frame.png)")
+    parser.add_argument("--save", metavar="FILE", help="also write the raw stream to FILE")
+    parser.add_argument("--no-trigger", action="store_true", help="do not send the menu keys")
+    args = parser.parse_args()
+
+    start = time.time()
+    chunks = open_source(args.source, not args.no_trigger, b"Tf")
+    raw = bytearray()
+
+    def recorded():
+        for c in chunks:
+            raw.extend(c)
+            yield c
+
+    try:
+        mode, width, height, lines = read_frame(Reader(recorded()))
+    except (EOFError, ValueError) as e:
+        print("grab failed: %s" % e, file=sys.stderr)
+        return 1
+    finally:
+        if args.save:
+            with open(args.save, "wb") as f:
+                f.write(raw)
+
+    write_png(args.output, width, height, [unpack_pixels(l) for l in lines])
+    print("%dx%d (%s mode), %d bytes in %.2f s -> %s" % (width, height, mode, len(raw), time.time() - start, args.output), file=sys.stderr)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
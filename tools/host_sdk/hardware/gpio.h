@@ -0,0 +1,17 @@
+#pragma once
+
+#include "pico.h"
+
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+enum gpio_function
+{
+    GPIO_FUNC_I2C = 3,
+};
+
+void gpio_init(uint gpio);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_pull_up(uint gpio);
+bool gpio_get(uint gpio);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "pico.h"
+
+typedef struct i2c_hw_t
+{
+    uint32_t sar; // slave address
+} i2c_hw_t;
+
+typedef struct i2c_inst
+{
+    i2c_hw_t *hw;
+    bool restart_on_next;
+} i2c_inst_t;
+
+extern i2c_inst_t i2c0_inst;
+#define i2c0 (&i2c0_inst)
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+uint i2c_hw_index(i2c_inst_t *i2c);
+uint8_t i2c_read_byte_raw(i2c_inst_t *i2c);
+void i2c_write_byte_raw(i2c_inst_t *i2c, uint8_t value);
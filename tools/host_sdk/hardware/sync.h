@@ -0,0 +1,7 @@
+#pragma once
+
+#include "pico.h"
+
+static inline void __sev(void)
+{
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "pico.h"
+
+uint32_t time_us_32();
+uint64_t time_us_64();
@@ -0,0 +1,15 @@
+#pragma once
+
+// host stand-in for the parts of the Pico SDK used by the sources the host tools build (tools/*)
+// declarations only, a tool that calls into the SDK links its own fakes (tools/ff_osd_replay/fake_sdk.c)
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef unsigned int uint;
+
+#define __not_in_flash_func(func_name) func_name
+
+#define PICO_HIGHEST_IRQ_PRIORITY 0x00
+#define I2C0_IRQ 23
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "hardware/i2c.h"
+
+typedef enum i2c_slave_event_t
+{
+    I2C_SLAVE_RECEIVE, // data from the master is available
+    I2C_SLAVE_REQUEST, // the master is requesting data
+    I2C_SLAVE_FINISH,  // Stop or Restart
+} i2c_slave_event_t;
+
+typedef void (*i2c_slave_handler_t)(i2c_inst_t *i2c, i2c_slave_event_t event);
+
+void i2c_slave_init(i2c_inst_t *i2c, uint8_t address, i2c_slave_handler_t handler);
+void i2c_slave_deinit(i2c_inst_t *i2c);
+
+// host side of the fake bus: every byte goes through the slave handler, as from the I2C IRQ
+void fake_i2c_write(const uint8_t *data, uint16_t len);
+void fake_i2c_read(uint8_t *data, uint16_t len);
+uint8_t fake_i2c_address();
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "pico.h"
+
+typedef struct stdio_driver
+{
+    void (*out_chars)(const char *buf, int len);
+} stdio_driver_t;
+
+extern stdio_driver_t stdio_usb;
+
+bool stdio_usb_connected();
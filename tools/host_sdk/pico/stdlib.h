@@ -0,0 +1,7 @@
+#pragma once
+
+#include "pico.h"
+#include "pico/time.h"
+#include "hardware/gpio.h"
+
+void irq_set_priority(uint num, uint8_t hardware_priority);
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "pico.h"
+
+typedef uint64_t absolute_time_t;
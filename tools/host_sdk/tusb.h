@@ -0,0 +1,6 @@
+#pragma once
+
+#include "pico.h"
+
+// free space in the CDC TX FIFO
+uint32_t tud_cdc_write_available();
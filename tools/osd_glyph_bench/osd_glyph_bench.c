@@ -0,0 +1,257 @@
+// host benchmark of the OSD pixel buffer renderer (src/osd.c) against the per-pixel osd_draw_char() it replaced
+// the firmware code draws through osd_text_print() and osd_render_text_to_buffer(), the old code is copied below
+// both must give the same pixels for every OSD line, exit code 1 if they do not
+// updates of a shown menu (cursor move, new double-height title) must not touch the screen before the vblank,
+// neither the pixel buffer nor the text the Scale2x OSD (osd_line_2x) is drawn from
+//
+// cc -O2 -DBOARD_36LJU22 -I tools/host_sdk -I src -o osd_glyph_bench tools/osd_glyph_bench/osd_glyph_bench.c src/osd.c
+// ./osd_glyph_bench
+//
+// host numbers: the ratio carries over to the RP2040, the times do not
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "hardware/gpio.h"
+#include "hardware/timer.h"
+
+#include "g_config.h"
+#include "osd.h"
+
+#ifdef OSD_TEXT_COMPOSITE
+#error the text compositor has no pixel buffer, build without OSD_TEXT_COMPOSITE
+#endif
+
+// output geometry the OSD is placed in (src/video_output.c)
+int16_t h_visible_area = 160;
+int16_t v_display_lines = 240;
+
+static uint8_t old_buffer[OSD_BUFFER_SIZE];
+
+void gpio_init(uint gpio)
+{
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+}
+
+void gpio_pull_up(uint gpio)
+{
+}
+
+bool gpio_get(uint gpio)
+{
+    return true;
+}
+
+uint64_t time_us_64()
+{
+    return 0;
+}
+
+// osd_draw_char() before the nibble lookup table: bounds checks and a read-modify-write for every pixel
+static void old_draw_char(uint8_t *buffer, uint16_t buf_width, uint16_t x, uint16_t y,
+                          uint8_t c, uint8_t fg_color, uint8_t bg_color, uint8_t height)
+{
+    const uint8_t *char_data = osd_font[c];
+    uint8_t height_multiplier = height ? 2 : 1;
+
+    for (int row = 0; row < OSD_FONT_HEIGHT; row++)
+    {
+        uint8_t line = char_data[row];
+
+        for (int pixel_row = 0; pixel_row < height_multiplier; pixel_row++)
+        {
+            uint16_t py = y + row * height_multiplier + pixel_row;
+
+            for (int col = 0; col < OSD_FONT_WIDTH; col++)
+            {
+                uint16_t px = x + col;
+                // Check bounds
+                if (px >= buf_width || py >= osd_mode.height)
+                    continue;
+                // Calculate buffer position (2 pixels per byte)
+                int buffer_offset = py * (buf_width / 2) + (px / 2);
+
+                if (buffer_offset >= osd_mode.buffer_size)
+                    continue;
+                // Determine pixel color
+                uint8_t pixel_color = (line & (0x80 >> col)) ? fg_color : bg_color;
+                // Set pixel in buffer (2 pixels per byte)
+                if (px & 1)
+                { // Odd pixel (upper 4 bits)
+                    buffer[buffer_offset] = (buffer[buffer_offset] & 0x0F) | (pixel_color << 4);
+                }
+                else
+                { // Even pixel (lower 4 bits)
+                    buffer[buffer_offset] = (buffer[buffer_offset] & 0xF0) | (pixel_color & 0x0F);
+                }
+            }
+        }
+    }
+}
+
+// osd_render_text_to_buffer() before the nibble lookup table: every cell, every time
+static void old_render_text()
+{
+    uint16_t y_offset = 0; // Accumulated Y offset for double-height rows
+
+    for (uint8_t row = 0; row < osd_mode.rows; row++)
+    {
+        uint8_t height = osd_text_heights[row];
+
+        for (uint8_t col = 0; col < osd_mode.columns; col++)
+        {
+            uint16_t pos = row * osd_mode.columns + col;
+            uint8_t packed_color = osd_text_colors[pos];
+
+            old_draw_char(old_buffer, osd_mode.width, col * OSD_FONT_WIDTH, row * OSD_FONT_HEIGHT + y_offset,
+                          (uint8_t)osd_text_buffer[pos], packed_color >> 4, packed_color & 0x0F, height);
+        }
+
+        if (height)
+            y_offset += OSD_FONT_HEIGHT;
+    }
+}
+
+static void new_render_text()
+{
+    osd_text_invalidate();
+    osd_render_text_to_buffer();
+    osd_vblank();
+}
+
+// a menu page: border, the title, items in several colours and the cursor line
+static void print_menu(const char *title, uint8_t title_height, uint8_t cursor)
+{
+    osd_text_print_centered(1, title, OSD_COLOR_SELECTED, OSD_COLOR_BACKGROUND, title_height);
+
+    for (uint8_t row = 2; row < osd_mode.rows - 1; row++)
+        osd_text_printf(row, 2, row == cursor ? OSD_COLOR_SELECTED : row & 1 ? OSD_COLOR_TEXT : OSD_COLOR_DIMMED,
+                        row == cursor ? OSD_COLOR_BORDER : OSD_COLOR_BACKGROUND, 0, "%-10s %3u %c%c", "ITEM", row * 37, 0xb3, 'A' + row);
+}
+
+static void fill_menu(uint8_t title_height)
+{
+    osd_clear_text_buffer();
+    osd_show();
+    osd_hide();
+    print_menu("SETTINGS", title_height, 5);
+}
+
+static int compare()
+{
+    uint16_t bytes_per_line = osd_mode.width / 2;
+    int differ = 0;
+
+    for (uint16_t line = 0; line < osd_mode.height; line++)
+        differ += memcmp(osd_line_pixels(line), &old_buffer[line * bytes_per_line], bytes_per_line) != 0;
+
+    return differ;
+}
+
+// glyph rows and colours of every Scale2x half-line of the OSD
+static void scale2x_lines(uint16_t bits[][2][OSD_LINE_COLUMNS], uint8_t colors[][2][OSD_LINE_COLUMNS])
+{
+    memset(bits, 0, OSD_HEIGHT * sizeof(bits[0]));
+    memset(colors, 0, OSD_HEIGHT * sizeof(colors[0]));
+
+    for (uint16_t line = 0; line < osd_mode.height; line++)
+        for (uint8_t half = 0; half < 2; half++)
+            osd_line_2x(line, half, bits[line][half], colors[line][half]);
+}
+
+// an update of the shown menu: the screen keeps the last version until the vblank, then shows the new one
+static int check_update(const char *name, const char *title, uint8_t title_height, uint8_t cursor)
+{
+    static uint8_t before[OSD_BUFFER_SIZE];
+    static uint16_t bits[2][OSD_HEIGHT][2][OSD_LINE_COLUMNS];
+    static uint8_t colors[2][OSD_HEIGHT][2][OSD_LINE_COLUMNS];
+    uint16_t bytes_per_line = osd_mode.width / 2;
+    int torn = 0;
+    int differ;
+
+    fill_menu(title_height);
+    osd_show();
+    new_render_text();
+    osd_render_text_to_buffer(); // the first render after a layout change draws in place
+
+    for (uint16_t line = 0; line < osd_mode.height; line++)
+        memcpy(&before[line * bytes_per_line], osd_line_pixels(line), bytes_per_line);
+
+    scale2x_lines(bits[0], colors[0]);
+    print_menu(title, title_height, cursor);
+    osd_render_text_to_buffer();
+    scale2x_lines(bits[1], colors[1]);
+
+    for (uint16_t line = 0; line < osd_mode.height; line++)
+        torn += memcmp(osd_line_pixels(line), &before[line * bytes_per_line], bytes_per_line) != 0;
+
+    torn += memcmp(bits[0], bits[1], sizeof(bits[0])) != 0 || memcmp(colors[0], colors[1], sizeof(colors[0])) != 0;
+
+    osd_vblank();
+    old_render_text();
+    differ = compare();
+    osd_hide();
+
+    printf("%-29s %s, %s\n", name, torn ? "DRAWN IN PLACE" : "switched at the vblank", differ ? "DIFFERENT PIXELS" : "same pixels");
+
+    return torn || differ;
+}
+
+static double now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double bench(void (*render)())
+{
+    uint32_t redraws = 0;
+    double start = now(), elapsed;
+
+    do
+    {
+        for (int i = 0; i < 100; i++)
+            render();
+
+        redraws += 100;
+        elapsed = now() - start;
+    } while (elapsed < 1.0);
+
+    return elapsed / redraws;
+}
+
+int main()
+{
+    int failures = 0;
+
+    osd_init();
+    osd_set_position();
+
+    for (uint8_t title_height = 0; title_height < 2; title_height++)
+    {
+        fill_menu(title_height);
+        memset(old_buffer, OSD_COLOR_BACKGROUND * 0x11, sizeof(old_buffer));
+
+        double t_old = bench(old_render_text);
+        double t_new = bench(new_render_text);
+        int differ = compare();
+        uint16_t glyphs = osd_mode.columns * osd_mode.rows;
+
+        failures += differ != 0;
+
+        printf("%ux%u %-14s old %7.1f us  new %6.1f us  (%5.1f / %4.1f ns per glyph)  %4.1fx  %s\n",
+               osd_mode.columns, osd_mode.rows, title_height ? "double title" : "single height",
+               t_old * 1e6, t_new * 1e6, t_old * 1e9 / glyphs, t_new * 1e9 / glyphs, t_old / t_new,
+               differ ? "DIFFERENT PIXELS" : "same pixels");
+    }
+
+    failures += check_update("cursor move", "SETTINGS", 0, 6);
+    failures += check_update("double-height title change", "OUTPUT", 1, 5);
+
+    return failures != 0;
+}
@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+"""
+Viewer and decoder for the delta-compressed video stream of the scan converter.
+
+The converter sends the displayed buffer at a reduced frame rate: a header and
+every line at each keyframe, then per frame only the lines that changed, each
+RLE-compressed (format in src/frame_grab.h). The frame rate follows the USB
+bandwidth, at most 25 frames per second. On a serial device the tool opens the
+configuration menu and sends the stream command itself (T, then v); any key
+sent to the device stops the stream.
+
+Examples:
+  stream_viewer.py /dev/ttyACM0 --view                  # live window (tkinter)
+  stream_viewer.py /dev/ttyACM0 --save rec.bin          # decode, keep the raw stream
+  stream_viewer.py rec.bin --png-dir frames             # one PNG per frame
+  stream_viewer.py tools/stream_sample.bin              # per-frame statistics
+
+tools/stream_sample.bin is recorded from the firmware's stream_update() built
+on the host (tools/usb_record); one frame in it is damaged on the link, the
+viewer drops it and picks up again at the next keyframe.
+
+Only the standard library is needed (tkinter for --view).
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+import zlib
+
+from frame_grab import HEADER, LINE_END, MAGIC, PALETTE, RECORD, VERSION, Reader, open_source, rle_decode, unpack_pixels, write_png
+
+MODE_STREAM = 2
+FRAME_START = 0xFFFE
+HEADER_SIZE = struct.calcsize(HEADER)
+RECORD_SIZE = struct.calcsize(RECORD)
+
+
+def frames(reader, stats):
+    """Yield (frame number, changed lines, width, height, lines) for every frame with a good CRC."""
+    lines = None
+    frame = None
+
+    while True:
+        try:
+            if lines is None or reader.peek(2) == MAGIC:
+                _, version, mode, width, height = struct.unpack(HEADER, reader.sync(MAGIC, HEADER_SIZE))
+
+                if version != VERSION or mode != MODE_STREAM or not (0 < width <= 4096 and 0 < height <= 4096):
+                    continue
+
+                if lines is None or len(lines) != height:
+                    lines = [bytes(width // 2)] * height
+
+                stats["keyframes"] += 1
+                continue
+
+            y, length = struct.unpack(RECORD, reader.read(RECORD_SIZE))
+
+            if length > width:
+                raise ValueError("record length")
+
+            data = reader.read(length)
+
+            if y == FRAME_START and length == 4:
+                (number,) = struct.unpack("<I", data)
+                frame = list(lines)
+                changed = 0
+                crc = 0
+            elif frame is None:
+                raise ValueError("record outside a frame")
+            elif y == LINE_END and length == 4:
+                if struct.unpack("<I", data)[0] != crc:
+                    raise ValueError("CRC")
+
+                lines, frame = frame, None
+                stats["frames"] += 1
+                yield number, changed, width, height, lines
+            elif y < height:
+                frame[y] = rle_decode(data, width // 2)
+                crc = zlib.crc32(frame[y], crc)
+                changed += 1
+            else:
+                raise ValueError("record")
+        except ValueError:
+            # damaged data: drop the frame and wait for the next keyframe
+            stats["errors"] += 1
+            lines = frame = None
+            reader.read(1)
+        except EOFError:
+            return
+
+
+def view(source_frames, scale):
+    import queue
+    import threading
+    import tkinter
+
+    q = queue.Queue(maxsize=2)
+
+    def decode():
+        for f in source_frames:
+            q.put(f)
+
+        q.put(None)
+
+    threading.Thread(target=decode, daemon=True).start()
+
+    root = tkinter.Tk()
+    root.title("scan converter stream")
+    label = tkinter.Label(root)
+    label.pack()
+    lut = [bytes(c) for c in PALETTE]
+
+    def poll():
+        try:
+            f = q.get_nowait()
+        except queue.Empty:
+            root.after(10, poll)
+            return
+
+        if f is None:
+            return
+
+        number, changed, width, height, lines = f
+        ppm = b"P6 %d %d 255\n" % (width, height) + b"".join(lut[p] for l in lines for p in unpack_pixels(l))
+        image = tkinter.PhotoImage(data=ppm, format="PPM").zoom(scale, scale)
+        label.configure(image=image)
+        label.image = image
+        root.title("scan converter stream - frame %d, %d lines changed" % (number, changed))
+        root.after(1, poll)
+
+    root.after(10, poll)
+    root.mainloop()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="scan converter video stream viewer")
+    parser.add_argument("source", help="serial device (/dev/ttyACM0) or a recorded stream")
+    parser.add_argument("--view", action="store_true", help="show the stream in a window")
+    parser.add_argument("--scale", type=int, default=2, help="window zoom (default: 2)")
+    parser.add_argument("--png-dir", metavar="DIR", help="write every frame as DIR/frame_NNNNN.png")
+    parser.add_argument("--save", metavar="FILE", help="also write the raw stream to FILE")
+    parser.add_argument("--no-trigger", action="store_true", help="do not send the menu keys")
+    args = parser.parse_args()
+
+    chunks = open_source(args.source, not args.no_trigger, b"Tv")
+    save = open(args.save, "wb") if args.save else None
+
+    def recorded():
+        for c in chunks:
+            if save:
+                save.write(c)
+
+            yield c
+
+    stats = dict(frames=0, keyframes=0, errors=0)
+    reader = Reader(recorded())
+    decoded = frames(reader, stats)
+    start = time.time()
+
+    try:
+        if args.view:
+            view(decoded, args.scale)
+        else:
+            if args.png_dir:
+                os.makedirs(args.png_dir, exist_ok=True)
+
+            for number, changed, width, height, lines in decoded:
+                if args.png_dir:
+                    write_png(os.path.join(args.png_dir, "frame_%05d.png" % number), width, height, [unpack_pixels(l) for l in lines])
+
+                print("frame %6d  %3d lines changed  %.2f s" % (number, changed, time.time() - start), flush=True)
+    except KeyboardInterrupt:
+        pass
+
+    print("frames %d, keyframes %d, errors %d, skipped bytes %d" % (stats["frames"], stats["keyframes"], stats["errors"], reader.skipped), file=sys.stderr)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,223 @@
+#!/usr/bin/env python3
+"""
+Decoder and plotter for the binary telemetry stream of the scan converter.
+
+Start the stream from the serial test menu (T, then l and a rate in Hz); any
+key sent to the device stops it. Packets are the telemetry_packet_t of
+src/telemetry.h: magic "ZT", version, size, fields little-endian, CRC-32 at the
+end. The decoder resynchronises on the magic, so menu text before or after
+the stream and damaged packets are skipped and counted.
+
+Examples:
+  telemetry_decoder.py /dev/ttyACM0                    # live, CSV on stdout
+  telemetry_decoder.py /dev/ttyACM0 --log soak.bin     # also keep the raw stream
+  telemetry_decoder.py tools/telemetry_sample.bin      # decode a capture
+  telemetry_decoder.py tools/telemetry_sample.bin --plot
+
+tools/telemetry_sample.bin is sent by the firmware's telemetry_update() built
+on the host (tools/usb_record): a 50 Hz source on a 60 Hz output, a signal
+loss, a capture overflow and one packet damaged on the link.
+
+--plot needs matplotlib, everything else only the standard library.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+# must match src/telemetry.h, its size and the offset of crc are pinned in src/telemetry.c
+MAGIC = b"ZT"
+VERSION = 1
+FORMAT = "<2sBBIIIIIIIHHIIII5IBBBBI"
+SIZE = struct.calcsize(FORMAT)
+FIELDS = (
+    "magic version size seq time_us in_frames out_frames frames_dropped frames_repeated "
+    "cap_samples frame_lines skipped frame_us cap_isr_cycles out_isr_cycles sys_clk_khz "
+    "h0 h1 h2 h3 h4 buf_in_idx buf_out_idx buf_free flags crc"
+).split()
+HEALTH = ("cap_overflow", "cap_dma_stop", "out_underrun", "out_overrun", "out_dma_stop")
+FLAG_NO_SIGNAL = 1 << 0
+FLAG_BUFFERING = 1 << 1
+FLAG_VGA = 1 << 2
+
+COLUMNS = (
+    "seq", "time_s", "in_hz", "out_hz", "pixel_mhz", "frame_lines", "frame_us", "dropped_s", "repeated_s",
+    "cap_load", "out_load", "buf_in", "buf_out", "buf_free", "no_signal", "skipped",
+) + HEALTH
+
+
+def packets(chunks, stats):
+    """Yield decoded packets (dicts) from an iterable of byte chunks."""
+    buf = b""
+
+    for chunk in chunks:
+        buf += chunk
+
+        while True:
+            i = buf.find(MAGIC)
+
+            if i < 0:
+                stats["junk"] += len(buf) - 1 if buf.endswith(MAGIC[:1]) else len(buf)
+                buf = buf[-1:] if buf.endswith(MAGIC[:1]) else b""
+                break
+
+            stats["junk"] += i
+            buf = buf[i:]
+
+            if len(buf) < 4:
+                break
+
+            if buf[2] != VERSION or buf[3] != SIZE:
+                stats["junk"] += 1
+                buf = buf[1:]
+                continue
+
+            if len(buf) < SIZE:
+                break
+
+            raw = buf[:SIZE]
+            p = dict(zip(FIELDS, struct.unpack(FORMAT, raw)))
+
+            if zlib.crc32(raw[:-4]) != p["crc"]:
+                stats["bad_crc"] += 1
+                buf = buf[1:]
+                continue
+
+            buf = buf[SIZE:]
+            stats["packets"] += 1
+            yield p
+
+
+def rows(stream, stats):
+    """Per-interval rates from consecutive packets."""
+    prev = None
+
+    for p in stream:
+        if prev is not None:
+            if p["seq"] != prev["seq"] + 1:
+                stats["seq_gaps"] += 1
+
+            dt = ((p["time_us"] - prev["time_us"]) & 0xFFFFFFFF) / 1e6
+
+            if dt > 0:
+                def rate(key):
+                    return ((p[key] - prev[key]) & 0xFFFFFFFF) / dt
+
+                # the capture frame counter restarts with the capture
+                in_frames = p["in_frames"] - prev["in_frames"] if p["in_frames"] >= prev["in_frames"] else p["in_frames"]
+                sys_hz = p["sys_clk_khz"] * 1000
+
+                yield {
+                    "seq": p["seq"],
+                    "time_s": p["time_us"] / 1e6,
+                    "in_hz": in_frames / dt,
+                    "out_hz": rate("out_frames"),
+                    "pixel_mhz": rate("cap_samples") / 1e6,
+                    "frame_lines": p["frame_lines"],
+                    "frame_us": p["frame_us"],
+                    "dropped_s": rate("frames_dropped"),
+                    "repeated_s": rate("frames_repeated"),
+                    "cap_load": 100 * rate("cap_isr_cycles") / sys_hz,
+                    "out_load": 100 * rate("out_isr_cycles") / sys_hz,
+                    "buf_in": p["buf_in_idx"],
+                    "buf_out": p["buf_out_idx"],
+                    "buf_free": p["buf_free"],
+                    "no_signal": int(bool(p["flags"] & FLAG_NO_SIGNAL)),
+                    "skipped": p["skipped"],
+                    **{name: p["h%d" % i] for i, name in enumerate(HEALTH)},
+                }
+
+        prev = p
+
+
+def read_chunks(path, log):
+    fd = os.open(path, os.O_RDONLY)
+
+    if os.isatty(fd):
+        import termios
+        import tty
+
+        tty.setraw(fd)
+        attrs = termios.tcgetattr(fd)
+        attrs[3] &= ~termios.ECHO
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+
+    try:
+        while True:
+            chunk = os.read(fd, 4096)
+
+            if not chunk:
+                break
+
+            if log:
+                log.write(chunk)
+                log.flush()
+
+            yield chunk
+    except KeyboardInterrupt:
+        pass
+    finally:
+        os.close(fd)
+
+
+def fmt(v):
+    return "%.3f" % v if isinstance(v, float) else str(v)
+
+
+def plot(data):
+    import matplotlib.pyplot as plt
+
+    t = [r["time_s"] for r in data]
+    fig, ax = plt.subplots(4, 1, sharex=True, figsize=(10, 9))
+
+    ax[0].plot(t, [r["in_hz"] for r in data], label="input")
+    ax[0].plot(t, [r["out_hz"] for r in data], label="output")
+    ax[0].set_ylabel("frames/s")
+    ax[1].plot(t, [r["pixel_mhz"] for r in data])
+    ax[1].set_ylabel("pixel clock, MHz")
+    ax[2].plot(t, [r["cap_load"] for r in data], label="capture")
+    ax[2].plot(t, [r["out_load"] for r in data], label="output")
+    ax[2].set_ylabel("ISR load, %")
+    ax[3].plot(t, [r["dropped_s"] for r in data], label="dropped")
+    ax[3].plot(t, [r["repeated_s"] for r in data], label="repeated")
+    ax[3].step(t, [r["no_signal"] for r in data], label="no signal")
+    ax[3].set_ylabel("per second")
+    ax[3].set_xlabel("time since boot, s")
+
+    for a in ax:
+        a.grid(True)
+        if a.get_legend_handles_labels()[0]:
+            a.legend(loc="upper right")
+
+    plt.tight_layout()
+    plt.show()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="scan converter telemetry decoder")
+    parser.add_argument("source", help="serial device (/dev/ttyACM0) or capture file")
+    parser.add_argument("--log", metavar="FILE", help="append the raw stream to FILE")
+    parser.add_argument("--plot", action="store_true", help="plot instead of printing CSV")
+    args = parser.parse_args()
+
+    stats = dict(packets=0, bad_crc=0, junk=0, seq_gaps=0)
+    log = open(args.log, "ab") if args.log else None
+    data = rows(packets(read_chunks(args.source, log), stats), stats)
+
+    if args.plot:
+        plot(list(data))
+    else:
+        print(",".join(COLUMNS))
+
+        for r in data:
+            print(",".join(fmt(r[c]) for c in COLUMNS), flush=True)
+
+    print("packets %d, bad CRC %d, sequence gaps %d, junk bytes %d" % (stats["packets"], stats["bad_crc"], stats["seq_gaps"], stats["junk"]), file=sys.stderr)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
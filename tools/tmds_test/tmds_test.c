@@ -0,0 +1,184 @@
+// host test of the TMDS encoder of the DVI output (src/tmds.c): the serialised palette words are
+// split back into the lanes, decoded as a DVI sink does and checked for DC balance and colour
+//
+// cc -O2 -DBOARD_36LJU22 -I tools/host_sdk -I src -o tmds_test tools/tmds_test/tmds_test.c src/tmds.c
+// cc -O2 -DBOARD_38LJE24 -I tools/host_sdk -I src -o tmds_test_rev tools/tmds_test/tmds_test.c src/tmds.c
+//
+// the second build covers the boards with DVI_PINS_REVERSED, exit code 1 on any failure
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "g_config.h"
+#include "tmds.h"
+
+#define COLOURS 512
+
+static int failures;
+
+static void fail(const char *what, uint32_t rgb, int channel)
+{
+  if (failures++ < 20)
+    fprintf(stderr, "%s: colour %06x channel %c\n", what, rgb, "RGB"[channel]);
+}
+
+// DVI 1.0, 3.3.3: 10b -> 8b
+static uint8_t tmds_decode(uint16_t sym)
+{
+  uint8_t d = sym & 0xff;
+  uint8_t out;
+
+  if (sym & (1u << 9))
+    d = ~d;
+
+  out = d & 1;
+
+  for (int i = 1; i < 8; i++)
+  {
+    uint8_t bit = ((d >> i) ^ (d >> (i - 1))) & 1;
+
+    if (!(sym & (1u << 8)))
+      bit ^= 1;
+
+    out |= bit << i;
+  }
+
+  return out;
+}
+
+// one serialiser word -> R, G, B symbols; false if a lane is not a valid differential pair
+static bool deserialize(uint64_t w, uint16_t sym[3])
+{
+  // 10 x 6 bits, bits 30-31 between the two halves and 62-63 unused
+  if (w & ((3ull << 30) | (3ull << 62)))
+    return false;
+
+  sym[0] = sym[1] = sym[2] = 0;
+
+  for (int i = 0; i < 10; i++)
+  {
+    uint8_t d6 = (w >> (6 * (9 - i) + (i < 5 ? 2 : 0))) & 0x3f;
+
+    for (int lane = 0; lane < 3; lane++)
+    {
+      uint8_t pair = (d6 >> (lane * 2)) & 3;
+
+      if (pair != 1 && pair != 2)
+        return false;
+
+#ifndef DVI_PINS_REVERSED
+      int channel = lane; // R, G, B from the lowest bits
+      uint16_t bit = pair == 1;
+#else
+      int channel = 2 - lane; // B, G, R from the lowest bits
+      uint16_t bit = pair - 1;
+#endif
+
+      sym[channel] = (sym[channel] << 1) | bit;
+    }
+  }
+
+  return true;
+}
+
+// every symbol of the running disparity encoder decodes to its input and the disparity
+// it reports is the DC of the bits sent
+static void test_encoder()
+{
+  int disparity = 0;
+  int max_disparity = 0;
+
+  srand(1);
+
+  for (int n = 0; n < 1000000; n++)
+  {
+    uint8_t d8 = n < 256 ? n : rand();
+    int before = disparity;
+    uint16_t sym = tmds_encoder(d8, &disparity);
+
+    if (tmds_decode(sym) != d8)
+      fail("encoder symbol does not decode", d8, 0);
+
+    if (disparity - before != 2 * __builtin_popcount(sym) - 10)
+      fail("encoder disparity", d8, 0);
+
+    if (abs(disparity) > max_disparity)
+      max_disparity = abs(disparity);
+  }
+
+  // the running DC stays bounded
+  if (max_disparity > 16)
+    fail("encoder disparity unbounded", max_disparity, 0);
+
+  printf("encoder: 1000000 symbols, |disparity| <= %d\n", max_disparity);
+}
+
+// palette entries as the DVI output sends them: the two words of a colour on alternate pixels
+static void test_palette()
+{
+  static uint32_t rgb[COLOURS];
+  static uint64_t pal[COLOURS * 2];
+  int exact = 0;
+  int from_encoder = 0;
+  int max_error = 0;
+
+  // all grey levels, every value of every channel, then random colours
+  for (int c = 0; c < COLOURS; c++)
+    rgb[c] = c < 256 ? c * 0x010101u : ((uint32_t)rand() << 8 ^ rand()) & 0xffffff;
+
+  tmds_palette_init(pal, rgb, COLOURS);
+
+  for (int c = 0; c < COLOURS; c++)
+  {
+    uint16_t sym[2][3];
+
+    if (!deserialize(pal[c * 2], sym[0]) || !deserialize(pal[c * 2 + 1], sym[1]))
+    {
+      fail("not a differential serialiser word", rgb[c], 0);
+      continue;
+    }
+
+    for (int ch = 0; ch < 3; ch++)
+    {
+      uint8_t want = rgb[c] >> (16 - ch * 8);
+      uint8_t got = tmds_decode(sym[0][ch]);
+      int error = abs(got - want);
+
+      if (tmds_decode(sym[1][ch]) != got)
+        fail("the two pixels decode to different values", rgb[c], ch);
+
+      if (__builtin_popcount(sym[0][ch]) + __builtin_popcount(sym[1][ch]) != 10)
+        fail("pair not DC balanced", rgb[c], ch);
+
+      if (error > 2)
+        fail("colour off by more than 2", rgb[c], ch);
+
+      if (error > max_error)
+        max_error = error;
+
+      if (c < 256 && ch == 0)
+      {
+        int disparity = 0;
+
+        exact += !error;
+        from_encoder += sym[0][ch] == tmds_encoder(got, &disparity) && sym[1][ch] == tmds_encoder(got, &disparity);
+      }
+    }
+  }
+
+  printf("palette: %d colours, %d of 256 values exact (max error %d), %d pairs from the running disparity encoder\n",
+         COLOURS, exact, max_error, from_encoder);
+}
+
+int main()
+{
+#ifdef DVI_PINS_REVERSED
+  printf("DVI pins reversed\n");
+#endif
+
+  test_encoder();
+  test_palette();
+
+  printf("%s\n", failures ? "FAIL" : "PASS");
+
+  return failures != 0;
+}
@@ -0,0 +1,502 @@
+// records what the firmware sends over USB CDC (src/frame_grab.c) on the host, against a simulated capture
+// and a CDC TX FIFO that the host drains in random steps; the CRC is the firmware one (src/telemetry.c)
+//
+// cc -O2 -DBOARD_36LJU22 -I tools/host_sdk -I src -o usb_record tools/usb_record/usb_record.c src/frame_grab.c src/telemetry.c src/v_buf.c src/g_config.c
+// ./usb_record --grab tools/grab_sample.bin       frame grab of a test picture, decoded by tools/frame_grab.py
+// ./usb_record --stream tools/stream_sample.bin   video stream of a moving sprite, decoded by tools/stream_viewer.py
+// ./usb_record --telemetry tools/telemetry_sample.bin
+//                                                 3 s of telemetry at 10 Hz: 50 Hz source, 60 Hz output, a signal
+//                                                 loss and a capture overflow, decoded by tools/telemetry_decoder.py
+//
+// exit code 1 if a record does not fit the room the firmware checked for, the grab is not the frame shown,
+// or a stream frame sent while the picture held still does not add up to that picture
+// (the stream keeps the lines it sent and checks them itself; one stream frame and one telemetry packet
+// are damaged on the link on purpose)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdio_usb.h"
+#include "hardware/clocks.h"
+#include "hardware/timer.h"
+#include "tusb.h"
+
+#include "g_config.h"
+#include "frame_grab.h"
+#include "health.h"
+#include "telemetry.h"
+#include "v_buf.h"
+
+#define CDC_TX_FIFO 256 // CFG_TUD_CDC_TX_BUFSIZE of the SDK's stdio_usb
+#define FRAME_US 20000  // 50 Hz source
+
+#define LINE_BYTES (V_BUF_W / 2)
+
+#define STREAM_FRAMES 80
+#define DAMAGED_FRAME 40 // a pixel byte of the first line sent from this frame on is changed on the link
+#define PICTURE_FRAMES 5 // the sprite moves every 5 source frames
+
+#define TELEMETRY_PACKETS 30
+#define DAMAGED_PACKET 25
+#define OUT_FRAME_US 16667     // 60 Hz output
+#define SIGNAL_LOST_US 1500000 // times from the start of the telemetry
+#define SIGNAL_BACK_US 2000000
+#define OVERFLOW_US 2200000
+
+settings_t settings;
+video_out_type_t active_video_output = VGA;
+
+// capture and output state the firmware sources read
+volatile uint32_t frame_count;
+volatile bool no_signal;
+volatile uint32_t cap_isr_cycles;
+volatile uint32_t cap_samples;
+volatile uint16_t cap_frame_lines;
+volatile uint32_t cap_frame_us;
+volatile uint32_t out_frame_count;
+volatile uint32_t out_isr_cycles;
+health_event_t health_events[HEALTH_EVENT_COUNT];
+
+static FILE *out;
+static uint32_t now_us;
+static uint32_t fifo_used;
+static uint32_t fifo_max;
+static int failures;
+
+// frame number drawn into each of the three buffers
+static uint32_t buf_frame[3];
+static void (*draw)(uint8_t *buf, uint32_t frame);
+
+// stream: what a viewer holds, built from the records sent
+static bool stream_mode;
+static uint8_t mirror[V_BUF_H][LINE_BYTES];
+static uint8_t picture[V_BUF_SZ];
+static uint32_t frame_number;
+static uint32_t frame_picture; // picture shown when the stream frame started
+static uint32_t last_picture;  // picture shown when the last stream frame ended
+static bool keyframe;
+static uint16_t lines_sent;
+static uint32_t stream_frames;
+static uint32_t stream_checked; // stream frames compared with the picture
+static long damage_at = -1;
+
+static bool telemetry_mode;
+static uint32_t packets;
+
+static void fail(const char *msg, uint32_t value)
+{
+    if (failures++ < 10)
+    {
+        fprintf(stderr, msg, value);
+        fputc('\n', stderr);
+    }
+}
+
+static int buf_index(const void *buf)
+{
+    return ((const uint8_t *)buf - g_v_buf) / V_BUF_SZ;
+}
+
+static uint32_t shown_picture()
+{
+    return buf_frame[buf_index(get_v_buf_shown())] / PICTURE_FRAMES;
+}
+
+// RLE as in src/frame_grab.h, false if the data does not make up exactly one line
+static bool rle_decode(const uint8_t *p, uint16_t n, uint8_t *line)
+{
+    const uint8_t *end = p + n;
+    uint16_t x = 0;
+
+    while (p < end)
+    {
+        uint8_t c = *p++;
+        uint16_t count = c < 0x80 ? c + 1 : (c & 0x7f) + 3;
+
+        if (x + count > LINE_BYTES || (c < 0x80 ? end - p < count : end - p < 1))
+            return false;
+
+        if (c < 0x80)
+            memcpy(&line[x], p, count);
+        else
+            memset(&line[x], *p, count);
+
+        p += c < 0x80 ? count : 1;
+        x += count;
+    }
+
+    return x == LINE_BYTES;
+}
+
+// every write of the stream is one header or one record
+static void parse_stream_write(const uint8_t *p, int len)
+{
+    grab_record_t r;
+    uint32_t value;
+
+    if (len == sizeof(grab_header_t) && ((const grab_header_t *)p)->magic == GRAB_MAGIC)
+    {
+        keyframe = true;
+        return;
+    }
+
+    memcpy(&r, p, sizeof(r));
+    memcpy(&value, p + sizeof(r), sizeof(value));
+
+    if (r.y == GRAB_FRAME_START)
+    {
+        frame_number = value;
+        frame_picture = shown_picture();
+        lines_sent = 0;
+    }
+    else if (r.y == GRAB_LINE_END)
+    {
+        bool same = frame_picture == last_picture && !keyframe;
+
+        keyframe = false;
+        stream_frames++;
+        last_picture = shown_picture();
+
+        // lines of a frame are read while the output goes on, only a still picture is one frame
+        if (last_picture != frame_picture)
+            return;
+
+        // between keyframes only the lines that changed are sent
+        if (same && lines_sent)
+            fail("stream frame %u: unchanged lines sent", stream_frames - 1);
+
+        draw(picture, frame_picture * PICTURE_FRAMES);
+        stream_checked++;
+
+        for (int y = 0; y < V_BUF_H; y++)
+            if (memcmp(mirror[y], &picture[y * LINE_BYTES], LINE_BYTES))
+            {
+                fail("stream frame %u: a changed line was not sent", stream_frames - 1);
+                break;
+            }
+    }
+    else if (r.y >= V_BUF_H || r.length != len - sizeof(r) || !rle_decode(p + sizeof(r), r.length, mirror[r.y]))
+        fail("bad stream record for line %u", r.y);
+    else
+    {
+        lines_sent++;
+
+        if (frame_number >= DAMAGED_FRAME && damage_at < 0)
+            damage_at = ftell(out) + len - 1;
+    }
+}
+
+static void out_chars(const char *buf, int len)
+{
+    uint8_t sent[CDC_TX_FIFO];
+    long pos = ftell(out);
+
+    if ((uint32_t)len > CDC_TX_FIFO - fifo_used)
+    {
+        fail("write larger than the free FIFO space: %u bytes", len);
+        return;
+    }
+
+    memcpy(sent, buf, len);
+
+    if (stream_mode)
+        parse_stream_write(sent, len);
+
+    if (telemetry_mode)
+    {
+        const telemetry_packet_t *p = (const telemetry_packet_t *)sent;
+
+        if (len != sizeof(telemetry_packet_t) || p->size != len || p->crc != crc32_update(0, p, offsetof(telemetry_packet_t, crc)))
+            fail("bad telemetry packet, %u bytes", len);
+        else if (p->seq == DAMAGED_PACKET)
+            damage_at = pos + offsetof(telemetry_packet_t, in_frames);
+
+        packets++;
+    }
+
+    if (damage_at >= pos && damage_at < pos + len)
+        sent[damage_at - pos] ^= 0x55;
+
+    fwrite(sent, 1, len, out);
+    fifo_used += len;
+
+    if (fifo_used > fifo_max)
+        fifo_max = fifo_used;
+}
+
+stdio_driver_t stdio_usb = {out_chars};
+
+bool stdio_usb_connected()
+{
+    return true;
+}
+
+uint32_t tud_cdc_write_available()
+{
+    return CDC_TX_FIFO - fifo_used;
+}
+
+uint32_t time_us_32()
+{
+    return now_us;
+}
+
+uint32_t clock_get_hz(enum clock_index clk_index)
+{
+    return 252000000;
+}
+
+// black border lines (runs longer than one RLE run), colour bars moving one step per frame, a bright box,
+// and noise lines: all literals, the longest records
+static void draw_picture(uint8_t *buf, uint32_t frame)
+{
+    for (int y = 0; y < V_BUF_H; y++)
+    {
+        uint8_t *line = &buf[y * LINE_BYTES];
+
+        for (int x = 0; x < LINE_BYTES; x++)
+            line[x] = ((x + frame) * 16 / LINE_BYTES % 16) * 0x11;
+
+        if (y < 16)
+            memset(line, 0, LINE_BYTES);
+
+        if (y >= 120 && y < 184)
+            memset(&line[80], 0xff, 48);
+
+        if (y >= 256 && y < 288)
+            for (int x = 0; x < LINE_BYTES; x++)
+                line[x] = (x * 73 + y * 31) ^ (x >> 1);
+    }
+}
+
+// a sprite moving over stripes, a new position every PICTURE_FRAMES frames
+static void draw_sprite(uint8_t *buf, uint32_t frame)
+{
+    uint32_t n = frame / PICTURE_FRAMES;
+    int x0 = 8 + n * 4 % (LINE_BYTES - 40);
+    int y0 = 40 + n * 2 % (V_BUF_H - 80);
+
+    for (int y = 0; y < V_BUF_H; y++)
+    {
+        memset(&buf[y * LINE_BYTES], ((y / 38) & 7) * 0x11, LINE_BYTES);
+
+        if (y >= y0 && y < y0 + 32)
+            memset(&buf[y * LINE_BYTES + x0], 0xee, 16);
+    }
+}
+
+// one source frame: VSYNC on the capture core, then the frame start of the output
+static void frame()
+{
+    uint8_t *buf = get_v_buf_in();
+
+    if (buf != NULL)
+    {
+        draw(buf, frame_count);
+        buf_frame[buf_index(buf)] = frame_count;
+    }
+
+    frame_count++;
+    get_v_buf_out();
+    out_frame_count++;
+}
+
+// main loop passes: the host takes up to drain - 1 bytes from the FIFO, then the firmware fills it again
+static void run(void (*update)(), bool (*active)(), uint32_t until_us, uint32_t pass_us, uint32_t drain)
+{
+    uint32_t next_frame = now_us;
+
+    while (active() && now_us < until_us)
+    {
+        if ((int32_t)(now_us - next_frame) >= 0)
+        {
+            frame();
+            next_frame += FRAME_US;
+        }
+
+        fifo_used -= fifo_used < drain ? fifo_used : rand() % drain;
+        update();
+        now_us += pass_us;
+    }
+}
+
+static int record_grab(const char *path)
+{
+    uint32_t crc = 0;
+    uint32_t sent_crc;
+    uint32_t shown;
+    long size;
+
+    draw = draw_picture;
+    clear_video_buffers();
+    set_buffering_mode(true);
+
+    for (int i = 0; i < 5; i++)
+        frame();
+
+    // 1 ms passes, up to 7 bytes taken each time: the free space grows in small steps, so records are
+    // sent with just about the room the firmware checked for
+    shown = buf_frame[buf_index(get_v_buf_shown())];
+    frame_grab_start();
+    run(frame_grab_update, frame_grab_active, now_us + 600000000, 1000, 8);
+
+    // the trailer holds the CRC of the lines sent: those of the frame shown when the grab started
+    fflush(out);
+    size = ftell(out);
+    fseek(out, size - 4, SEEK_SET);
+
+    if (fread(&sent_crc, 4, 1, out) != 1)
+        sent_crc = ~0u;
+
+    draw_picture(g_v_buf, shown);
+
+    for (int y = 0; y < V_BUF_H; y++)
+        crc = crc32_update(crc, &g_v_buf[y * LINE_BYTES], LINE_BYTES);
+
+    if (frame_grab_active())
+        fail("grab not finished after %u s", 600);
+    else if (sent_crc != crc)
+        fail("grab is not frame %u", shown);
+
+    printf("%s %s: frame %u, %ld bytes in %u ms, FIFO up to %u of %u bytes\n", failures ? "FAIL" : "PASS", path,
+           shown, size, now_us / 1000, fifo_max, CDC_TX_FIFO);
+
+    return failures != 0;
+}
+
+// capture VSYNC: as in rgb_capture.c, a lost signal stops VSYNC and the sync watchdog clears the buffer,
+// NO SIGNAL stays until a whole frame has been captured again; the DMA ISR runs either way
+static void capture_vsync(bool signal)
+{
+    static uint8_t *cap_buf;
+
+    cap_samples += 7000000 / (1000000 / FRAME_US);
+    cap_isr_cycles += 252000000 / 100 * 38 / (1000000 / FRAME_US);
+
+    if (!signal)
+    {
+        no_signal = true;
+        cap_buf = NULL;
+        return;
+    }
+
+    if (cap_buf != NULL)
+        no_signal = false;
+
+    cap_buf = get_v_buf_in();
+
+    if (cap_buf != NULL)
+        draw(cap_buf, frame_count);
+
+    cap_frame_lines = 312;
+    cap_frame_us = FRAME_US;
+    frame_count++;
+}
+
+static int record_telemetry(const char *path)
+{
+    uint32_t start, next_vsync, next_out;
+
+    draw = draw_picture;
+    telemetry_mode = true;
+    now_us = 10000000; // 10 s after boot
+    clear_video_buffers();
+    set_buffering_mode(true);
+
+    telemetry_start(10);
+    start = next_vsync = next_out = now_us;
+
+    while (packets < TELEMETRY_PACKETS && now_us - start < 10000000)
+    {
+        uint32_t t = now_us - start;
+
+        if ((int32_t)(now_us - next_vsync) >= 0)
+        {
+            capture_vsync(t < SIGNAL_LOST_US || t >= SIGNAL_BACK_US);
+            next_vsync += FRAME_US;
+        }
+
+        if ((int32_t)(now_us - next_out) >= 0)
+        {
+            get_v_buf_out();
+            out_frame_count++;
+            out_isr_cycles += 252000000 / 100 * 61 / 60;
+            next_out += OUT_FRAME_US;
+        }
+
+        if (t == OVERFLOW_US)
+            health_events[HEALTH_CAP_OVERFLOW].count++;
+
+        fifo_used -= fifo_used < 128 ? fifo_used : rand() % 128;
+        telemetry_update();
+        now_us += 1000;
+    }
+
+    telemetry_stop();
+
+    if (packets != TELEMETRY_PACKETS)
+        fail("%u telemetry packets in 10 s", packets);
+
+    printf("%s %s: %u packets, %u frames in, %u out, %u repeated, %ld bytes\n", failures ? "FAIL" : "PASS", path,
+           packets, frame_count, out_frame_count, frames_repeated, ftell(out));
+
+    return failures != 0;
+}
+
+static bool streaming()
+{
+    return stream_frames < STREAM_FRAMES;
+}
+
+static int record_stream(const char *path)
+{
+    draw = draw_sprite;
+    stream_mode = true;
+    last_picture = ~0u;
+    clear_video_buffers();
+    set_buffering_mode(true);
+
+    for (int i = 0; i < 5; i++)
+        frame();
+
+    // 100 us passes, up to 127 bytes taken each time: about 640 kB/s, a full speed CDC link
+    frame_stream_start();
+    run(frame_grab_update, streaming, now_us + 60000000, 100, 128);
+    frame_grab_stop();
+
+    if (streaming())
+        fail("%u stream frames in 60 s", stream_frames);
+    else if (stream_checked < STREAM_FRAMES / 2)
+        fail("only %u stream frames with a still picture", stream_checked);
+
+    printf("%s %s: %u frames, %u compared with the picture, %ld bytes in %u ms\n", failures ? "FAIL" : "PASS", path,
+           stream_frames, stream_checked, ftell(out), now_us / 1000);
+
+    return failures != 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3 || (strcmp(argv[1], "--grab") && strcmp(argv[1], "--stream") && strcmp(argv[1], "--telemetry")))
+    {
+        fprintf(stderr, "usage: %s --grab | --stream | --telemetry <file>\n", argv[0]);
+        return 2;
+    }
+
+    out = fopen(argv[2], "w+b");
+
+    if (out == NULL)
+    {
+        perror(argv[2]);
+        return 2;
+    }
+
+    srand(1);
+
+    int rc = !strcmp(argv[1], "--grab")     ? record_grab(argv[2])
+             : !strcmp(argv[1], "--stream") ? record_stream(argv[2])
+                                            : record_telemetry(argv[2]);
+
+    fclose(out);
+    return rc;
+}
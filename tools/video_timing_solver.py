@@ -0,0 +1,384 @@
+#!/usr/bin/env python3
+"""
+Video timing solver for the RP2040 scan converter.
+
+Searches the RP2040 system PLL (12 MHz crystal) and the PIO/capture clock
+dividers for a given VESA/CEA/CVT mode and emits validated `video_mode_t`
+entries for src/g_config.c.
+
+Examples:
+  video_timing_solver.py --list
+  video_timing_solver.py 1280x960_60Hz --div 3 4
+  video_timing_solver.py --cvt 1024x768@50 --div 3
+  video_timing_solver.py 640x480_60Hz --dvi
+  video_timing_solver.py --verify src/g_config.c
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+XOSC_HZ = 12000000
+VCO_MIN_HZ = 750000000
+VCO_MAX_HZ = 1600000000
+
+# must match g_config.h
+V_BUF_H = 304
+FREQUENCY_MIN = 6000000
+FREQUENCY_MAX = 8000000
+FREQUENCY_DEF = 7000000
+
+# pixel clock, h: visible/front/sync/back, v: visible/front/sync/back, polarity (True = positive)
+MODES = {
+    # VESA DMT
+    "640x480_60Hz": (25175000, (640, 16, 96, 48), (480, 10, 2, 33), False),
+    "800x600_60Hz": (40000000, (800, 40, 128, 88), (600, 1, 4, 23), True),
+    "1024x768_60Hz": (65000000, (1024, 24, 136, 160), (768, 3, 6, 29), False),
+    "1152x864_75Hz": (108000000, (1152, 64, 128, 256), (864, 1, 3, 32), True),
+    "1280x960_60Hz": (108000000, (1280, 96, 112, 312), (960, 1, 3, 36), True),
+    "1280x1024_60Hz": (108000000, (1280, 48, 112, 248), (1024, 1, 3, 38), True),
+    # CEA-861
+    "720x576_50Hz": (27000000, (720, 12, 64, 68), (576, 5, 5, 39), False),
+    "1280x720_50Hz": (74250000, (1280, 440, 40, 220), (720, 5, 5, 20), True),
+    "1280x720_60Hz": (74250000, (1280, 110, 40, 220), (720, 5, 5, 20), True),
+}
+
+
+def f32(x):
+    return struct.unpack("f", struct.pack("f", x))[0]
+
+
+def pio_clkdiv(div):
+    # pio_calculate_clkdiv_from_float(): 16.8 fixed point, fraction truncated
+    div = f32(div)
+    div_int = int(div)
+    div_frac = int((div - div_int) * 256) if div_int else 0
+    return div_int, div_frac
+
+
+def sys_clocks(min_khz, max_khz):
+    # exact frequencies reachable by set_sys_clock_khz(), same search space as check_sys_clock_khz()
+    freqs = {}
+
+    for fbdiv in range(16, 321):
+        vco = XOSC_HZ * fbdiv
+
+        if vco < VCO_MIN_HZ or vco > VCO_MAX_HZ:
+            continue
+
+        for pd1 in range(1, 8):
+            for pd2 in range(1, pd1 + 1):
+                hz = vco // (pd1 * pd2)
+
+                if vco % (pd1 * pd2) or hz % 1000:
+                    continue
+
+                khz = hz // 1000
+
+                if min_khz <= khz <= max_khz and khz not in freqs:
+                    freqs[khz] = (vco, pd1, pd2)
+
+    return freqs
+
+
+def cvt(width, height, refresh):
+    # VESA CVT 1.1, standard blanking, non-interlaced, no margins
+    CELL_GRAN = 8
+    MIN_V_PORCH = 3
+    MIN_V_BPORCH = 6
+    MIN_VSYNC_BP = 550.0
+    C_PRIME = 30.0
+    M_PRIME = 300.0
+    CLOCK_STEP = 0.25
+
+    aspect = width / height
+    v_sync = 10
+
+    for ratio, lines in ((4 / 3, 4), (16 / 9, 5), (16 / 10, 6), (5 / 4, 7), (15 / 9, 7)):
+        if abs(aspect - ratio) < 0.01:
+            v_sync = lines
+            break
+
+    h_active = width // CELL_GRAN * CELL_GRAN
+    h_period = (1000000.0 / refresh - MIN_VSYNC_BP) / (height + MIN_V_PORCH)
+    v_sync_bp = max(int(MIN_VSYNC_BP / h_period) + 1, v_sync + MIN_V_BPORCH)
+
+    duty = max(C_PRIME - M_PRIME * h_period / 1000.0, 20.0)
+    h_blank = int(h_active * duty / (100.0 - duty) / (2 * CELL_GRAN)) * 2 * CELL_GRAN
+    h_total = h_active + h_blank
+    pixel_mhz = CLOCK_STEP * int(h_total / h_period / CLOCK_STEP)
+    h_sync = int(0.08 * h_total / CELL_GRAN) * CELL_GRAN
+    h_back = h_blank // 2
+
+    # CVT uses -hsync +vsync, the firmware has a single polarity bit for both: use negative
+    return (int(pixel_mhz * 1000000), (h_active, h_blank - h_sync - h_back, h_sync, h_back),
+            (height, MIN_V_PORCH, v_sync, v_sync_bp - v_sync), False)
+
+
+def fit_horizontal(h, whole_units, div):
+    # round all horizontal parts to whole PIO units, the difference in the line length goes to the back porch
+    visible = h[0] // div * div
+    front = max(div, round((h[0] + h[1]) / div) * div - visible)
+    sync = max(div, round(h[2] / div) * div)
+    back = whole_units * div - visible - front - sync
+
+    # video_mode_t keeps porches and sync in uint8_t
+    if back > 255:
+        front += back - 255
+        back = 255
+
+    if back < div or front > 255 or sync > 255:
+        return None
+
+    return visible, front, sync, back
+
+
+def solve(name, mode, args, out_type, div):
+    pixel_freq, h, v, positive = mode
+    nominal_line = sum(h)
+    h_freq = pixel_freq / nominal_line
+    results = []
+
+    for khz, pll in sys_clocks(args.min_sys, args.max_sys).items():
+        sys_hz = khz * 1000
+        problems = []
+
+        if out_type == "dvi":
+            # one TMDS character per 10 system clocks
+            unit_hz = sys_hz / 10.0
+            div_int, div_frac = 1, 0
+            whole_units = round(unit_hz / h_freq)
+            hp = (h[0], h[1], h[2], whole_units - h[0] - h[1] - h[2])
+
+            if not 0 < hp[3] <= 255 or h[1] > 255 or h[2] > 255:
+                continue
+
+            real_pixel_hz = unit_hz
+        else:
+            div_int, div_frac = pio_clkdiv(sys_hz * div / pixel_freq)
+
+            if div_int < 1:
+                continue
+
+            unit_hz = sys_hz / (div_int + div_frac / 256.0)
+            # line buffer is DMA'd in 32-bit words: whole_line / div has to be a multiple of 4 units
+            whole_units = round(unit_hz / h_freq / 4) * 4
+            hp = fit_horizontal(h, whole_units, div)
+
+            if hp is None:
+                continue
+
+            real_pixel_hz = unit_hz * div
+
+        real_line = sum(hp)
+        h_err = (real_pixel_hz / real_line) / h_freq - 1.0
+        pix_err = real_pixel_hz / pixel_freq - 1.0
+
+        if abs(h_err) > args.max_error / 1e6:
+            continue
+
+        # DVI sinks lock to the TMDS clock, it has to stay close to the nominal pixel clock as well
+        if out_type == "dvi" and abs(pix_err) > args.max_error / 1e6:
+            continue
+
+        if div_frac:
+            problems.append("fractional PIO divider (jitter)")
+
+        # capture PIO runs at 12x the source pixel clock
+        cap_err = 0.0
+
+        for f in args.cap_freq:
+            c_int, c_frac = pio_clkdiv(sys_hz / (f * 12.0))
+
+            if c_int < 1:
+                problems.append("capture clock %d Hz too high" % f)
+                continue
+
+            cap_err = max(cap_err, abs(sys_hz / (c_int + c_frac / 256.0) / (f * 12.0) - 1.0))
+
+        cost = abs(h_err) * 1e6 + args.cap_weight * cap_err * 1e6 + (args.jitter_penalty if div_frac else 0)
+
+        results.append({
+            "sys_khz": khz, "pll": pll, "clkdiv": (div_int, div_frac), "h": hp, "whole_line": real_line,
+            "pixel_hz": real_pixel_hz, "pix_err": pix_err, "h_err": h_err, "cap_err": cap_err,
+            "cycles": sys_hz / (real_pixel_hz / real_line), "problems": problems, "cost": cost,
+        })
+
+    results.sort(key=lambda r: (r["cost"], -r["sys_khz"]))
+    return results
+
+
+def vertical_notes(v, div):
+    lines = V_BUF_H * div
+
+    if lines > v[0]:
+        return "captured frame cropped by %d source lines" % ((lines - v[0] + div - 1) // div)
+
+    return "vertical margin %d lines" % ((v[0] - lines) // 2)
+
+
+def emit(name, mode, r, v, div, out_type):
+    pixel_freq = mode[0] if out_type == "vga" else r["pixel_hz"]
+    h = r["h"]
+    suffix = "_d%d" % div if out_type == "vga" and div != 2 else ""
+    polarity = "0b00000000, // positive" if mode[3] else "0b11000000, // negative"
+
+    print("video_mode_t mode_%s%s = {" % (name, suffix))
+    print("    .sys_freq = %d," % r["sys_khz"])
+    print("    .pixel_freq = %.1f," % pixel_freq)
+    print("    .h_visible_area = %d,%s" % (h[0], "" if h[0] == mode[1][0] else " // %d" % mode[1][0]))
+    print("    .v_visible_area = %d," % v[0])
+    print("    .whole_line = %d,%s" % (r["whole_line"], "" if r["whole_line"] == sum(mode[1]) else " // %d" % sum(mode[1])))
+    print("    .whole_frame = %d," % sum(v))
+
+    for field, value, nominal in zip(("h_front_porch", "h_sync_pulse", "h_back_porch"), h[1:], mode[1][1:]):
+        print("    .%s = %d,%s" % (field, value, "" if value == nominal else " // %d" % nominal))
+
+    print("    .v_front_porch = %d," % v[1])
+    print("    .v_sync_pulse = %d," % v[2])
+    print("    .v_back_porch = %d," % v[3])
+    print("    .sync_polarity = %s" % polarity)
+    print("    .div = %d," % div)
+    print("};")
+
+
+def report(name, mode, args, out_type, div):
+    results = solve(name, mode, args, out_type, div)
+    v = mode[2]
+
+    print("// %s %s div %d: %s" % (name, out_type.upper(), div, vertical_notes(v, div)))
+
+    if not results:
+        print("// no solution within %d..%d kHz and %d ppm\n" % (args.min_sys, args.max_sys, args.max_error))
+        return False
+
+    for r in results[:args.top]:
+        vco, pd1, pd2 = r["pll"]
+        print("//   sys %7.3f MHz (VCO %4d MHz /%d/%d) clkdiv %d+%d/256 line %4d: pixel %+6.0f ppm, h-freq %+6.0f ppm, capture %5.0f ppm, %4.0f cycles/line%s" % (
+            r["sys_khz"] / 1000.0, vco // 1000000, pd1, pd2, r["clkdiv"][0], r["clkdiv"][1], r["whole_line"],
+            r["pix_err"] * 1e6, r["h_err"] * 1e6, r["cap_err"] * 1e6, r["cycles"],
+            "".join(", " + p for p in r["problems"])))
+
+    emit(name, mode, results[0], v, div, out_type)
+    print()
+    return True
+
+
+def verify(path):
+    # check video_mode_t entries of g_config.c against the constraints of vga.c/dvi.c
+    text = open(path).read()
+    ok = True
+    sys_ok = sys_clocks(0, 1000000)
+
+    for name, body in re.findall(r"video_mode_t\s+(\w+)\s*=\s*\{(.*?)\};", text, re.S):
+        m = {k: float(val) for k, val in re.findall(r"\.(\w+)\s*=\s*([0-9.]+)", body)}
+        div = int(m["div"])
+        h = [int(m[k]) for k in ("h_visible_area", "h_front_porch", "h_sync_pulse", "h_back_porch")]
+        errors = []
+
+        if int(m["sys_freq"]) not in sys_ok:
+            errors.append("sys_freq not reachable by the PLL")
+
+        if sum(h) != m["whole_line"]:
+            errors.append("h parts sum to %d, whole_line is %d" % (sum(h), m["whole_line"]))
+
+        if (h[0] + h[1]) % div or h[2] % div or m["whole_line"] % div:
+            errors.append("horizontal sync edges not aligned to div")
+
+        if (m["whole_line"] // div) % 4:
+            errors.append("whole_line / div not a multiple of 4 (VGA DMA words)")
+
+        v = sum(int(m[k]) for k in ("v_visible_area", "v_front_porch", "v_sync_pulse", "v_back_porch"))
+
+        if v != m["whole_frame"]:
+            errors.append("v parts sum to %d, whole_frame is %d" % (v, m["whole_frame"]))
+
+        div_int, div_frac = pio_clkdiv(m["sys_freq"] * 1000 * div / m["pixel_freq"])
+        unit_hz = m["sys_freq"] * 1000 / (div_int + div_frac / 256.0)
+        h_err = unit_hz * div / m["whole_line"] / (m["pixel_freq"] / sum(h)) - 1.0
+        notes = []
+
+        if div_frac:
+            notes.append("fractional PIO divider (jitter)")
+
+        # DVI capable modes run the system clock at 10x the pixel clock
+        dvi_err = m["sys_freq"] * 100 / m["pixel_freq"] - 1.0
+
+        if abs(dvi_err) < 0.01:
+            notes.append("DVI pixel clock %+.0f ppm" % (dvi_err * 1e6))
+
+        print("%-24s %s VGA clkdiv %d+%d/256, line rate %+.0f ppm" % (
+            name, "OK  " if not errors else "FAIL", div_int, div_frac, h_err * 1e6))
+
+        for e in errors:
+            print("    error: " + e)
+
+        for n in notes:
+            print("    note: " + n)
+
+        ok &= not errors
+
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description="RP2040 video timing solver")
+    parser.add_argument("mode", nargs="*", help="mode names from --list")
+    parser.add_argument("--list", action="store_true", help="list built-in VESA/CEA modes")
+    parser.add_argument("--cvt", action="append", default=[], metavar="WxH@R", help="generate CVT timing")
+    parser.add_argument("--dvi", action="store_true", help="solve for DVI output (sys = 10 x pixel clock)")
+    parser.add_argument("--div", type=int, nargs="+", default=[2, 3, 4], help="VGA pixel dividers to try")
+    parser.add_argument("--min-sys", type=int, default=120000, help="min system clock, kHz")
+    parser.add_argument("--max-sys", type=int, default=280000, help="max system clock, kHz")
+    parser.add_argument("--max-error", type=int, default=5000, help="max line rate error, ppm")
+    parser.add_argument("--cap-freq", type=int, nargs="+", default=[FREQUENCY_DEF], help="source pixel clocks, Hz")
+    parser.add_argument("--cap-weight", type=float, default=1.0, help="weight of capture clock error")
+    parser.add_argument("--jitter-penalty", type=float, default=2000.0, help="cost of a fractional PIO divider, ppm")
+    parser.add_argument("--top", type=int, default=5, help="candidates to show")
+    parser.add_argument("--verify", metavar="G_CONFIG_C", help="check existing video_mode_t entries")
+    args = parser.parse_args()
+
+    if args.verify:
+        return 0 if verify(args.verify) else 1
+
+    if args.list:
+        for name, (pixel_freq, h, v, positive) in MODES.items():
+            print("%-16s %8.3f MHz  %4d %4d %4d %4d  %4d %2d %2d %2d  %s" % (
+                name, pixel_freq / 1e6, *h, *v, "positive" if positive else "negative"))
+        return 0
+
+    for f in args.cap_freq:
+        if not FREQUENCY_MIN <= f <= FREQUENCY_MAX:
+            parser.error("capture frequency %d out of %d..%d" % (f, FREQUENCY_MIN, FREQUENCY_MAX))
+
+    modes = []
+
+    for name in args.mode:
+        if name not in MODES:
+            parser.error("unknown mode %s, see --list" % name)
+        modes.append((name, MODES[name]))
+
+    for spec in args.cvt:
+        m = re.fullmatch(r"(\d+)x(\d+)@(\d+)", spec)
+
+        if not m:
+            parser.error("bad CVT mode %s" % spec)
+
+        w, h, r = map(int, m.groups())
+        modes.append(("%dx%d_%dHz" % (w, h, r), cvt(w, h, r)))
+
+    if not modes:
+        parser.error("no mode given")
+
+    ok = True
+
+    for name, mode in modes:
+        for div in ([2] if args.dvi else args.div):
+            ok &= report(name, mode, args, "dvi" if args.dvi else "vga", div)
+
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())